@@ -22,6 +22,28 @@ void AsyncCommand::SyncExecuteImpl()
 	}
 }
 
+void AsyncCommand::InformListener(CommandListener* listener, std::exception_ptr exc)
+{
+	if (!exc)
+	{
+		listener->CommandSucceeded();
+		return;
+	}
+
+	try
+	{
+		std::rethrow_exception(exc);
+	}
+	catch (CommandAbortedException&)
+	{
+		listener->CommandAborted();
+	}
+	catch (std::exception& e)
+	{
+		listener->CommandFailed(e, std::current_exception());
+	}
+}
+
 AsyncCommand::Listener::Listener(AsyncCommand* command) : m_command(command)
 {
 }
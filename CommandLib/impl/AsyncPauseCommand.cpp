@@ -0,0 +1,167 @@
+#include "AsyncPauseCommand.h"
+
+using namespace CommandLib;
+
+AsyncPauseCommand::Ptr AsyncPauseCommand::Create(long long ms)
+{
+	return Create(ms, Waitable::Ptr());
+}
+
+AsyncPauseCommand::Ptr AsyncPauseCommand::Create(long long ms, Waitable::Ptr stopEvent)
+{
+	return Ptr(new AsyncPauseCommand(ms, stopEvent));
+}
+
+std::string AsyncPauseCommand::ClassName() const
+{
+	return "AsyncPauseCommand";
+}
+
+AsyncPauseCommand::AsyncPauseCommand(long long ms, Waitable::Ptr stopEvent)
+	: m_externalCutShortEvent(stopEvent),
+	m_milliseconds(ms)
+{
+	if (m_externalCutShortEvent)
+	{
+		// The monitor stays registered for the lifetime of this object. Signals that arrive while not executing are ignored.
+		m_stopMonitor.reset(new StopMonitor(this));
+		m_externalCutShortEvent->AddListener(m_stopMonitor);
+	}
+}
+
+AsyncPauseCommand::~AsyncPauseCommand()
+{
+	if (m_stopMonitor)
+	{
+		m_externalCutShortEvent->RemoveListener(m_stopMonitor);
+	}
+}
+
+void AsyncPauseCommand::CutShort()
+{
+	Finish(Outcome::Succeeded);
+}
+
+void AsyncPauseCommand::Reset()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_active)
+	{
+		TimerService::Default()->Cancel(m_timerId);
+		StartTimer();
+	}
+}
+
+long long AsyncPauseCommand::GetDurationMS() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_milliseconds;
+}
+
+void AsyncPauseCommand::SetDurationMS(long long ms)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_milliseconds = ms;
+}
+
+std::string AsyncPauseCommand::ExtendedDescription() const
+{
+	return "Duration: " + std::to_string(GetDurationMS()) + "ms";
+}
+
+void AsyncPauseCommand::AsyncExecuteImpl(CommandListener* listener)
+{
+	// Once the timer is started, the listener may be informed and this object destroyed before this method returns
+	Command::Ptr thisCommand = shared_from_this();
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+		m_active = true;
+		StartTimer();
+	}
+
+	// These checks must follow activation. Otherwise an abort or stop signal that arrives in between would be missed.
+	if (AbortEvent()->IsSignaled())
+	{
+		Finish(Outcome::Aborted);
+	}
+	else if (m_externalCutShortEvent && m_externalCutShortEvent->IsSignaled())
+	{
+		Finish(Outcome::Succeeded);
+	}
+}
+
+void AsyncPauseCommand::AbortImpl()
+{
+	Finish(Outcome::Aborted);
+}
+
+void AsyncPauseCommand::StartTimer()
+{
+	// Must be called while holding m_mutex
+	// The generation identifies this particular timer, so that one superseded by a reset is ignored if it fires anyway.
+	const unsigned long long generation = ++m_generation;
+	Command::Ptr thisCommand = shared_from_this();
+	m_timerId = TimerService::Default()->Schedule(m_milliseconds, [this, thisCommand, generation]() { OnTimer(generation); });
+}
+
+void AsyncPauseCommand::OnTimer(unsigned long long generation)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (!m_active || generation != m_generation)
+		{
+			return; // stale timer from before a reset
+		}
+	}
+
+	Finish(Outcome::Succeeded);
+}
+
+void AsyncPauseCommand::Finish(Outcome outcome)
+{
+	CommandListener* listener;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (!m_active)
+		{
+			return;
+		}
+
+		m_active = false;
+		TimerService::Default()->Cancel(m_timerId);
+		m_timerId = 0;
+		listener = m_listener;
+		m_listener = nullptr;
+	}
+
+	// Never inform the listener from here. This may be running within AsyncExecute, upon the timer thread, or while a
+	// Waitable is notifying its listeners.
+	Command::Ptr thisCommand = shared_from_this();
+
+	GetExecutor()->Execute([thisCommand, listener, outcome]()
+	{
+		if (outcome == Outcome::Aborted)
+		{
+			listener->CommandAborted();
+		}
+		else
+		{
+			listener->CommandSucceeded();
+		}
+	});
+}
+
+AsyncPauseCommand::StopMonitor::StopMonitor(AsyncPauseCommand* command) : m_command(command)
+{
+}
+
+void AsyncPauseCommand::StopMonitor::Signaled(const Waitable&)
+{
+	m_command->CutShort();
+}
@@ -0,0 +1,19 @@
+#include "BacklogFullException.h"
+
+using namespace CommandLib;
+
+BacklogFullException::BacklogFullException() : std::runtime_error("The backlog is full")
+{
+}
+
+BacklogFullException::BacklogFullException(const char* message) : std::runtime_error(message)
+{
+}
+
+BacklogFullException::BacklogFullException(const std::string& message) : std::runtime_error(message)
+{
+}
+
+BacklogFullException::~BacklogFullException()
+{
+}
@@ -1,30 +1,57 @@
 ﻿#include "Command.h"
 #include "CommandAbortedException.h"
+#include "ThreadPool.h"
+#include <algorithm>
 
 using namespace CommandLib;
 
-Command::ListenerProxy::ListenerProxy(Command* command, CommandListener* listener) : m_command(command), m_listener(listener), m_asyncExeThreadId(std::this_thread::get_id())
+namespace
 {
+	// The listener proxies whose AsyncExecuteImpl() call is still in progress on the current thread. Commands now run upon
+	// shared worker threads, so a callback may legitimately arrive on the thread that called AsyncExecute, as long as it
+	// arrives after that call has returned. What must never happen is a callback from within the AsyncExecute call itself.
+	thread_local std::vector<const CommandListener*> tl_launchingProxies;
+
+	class LaunchScope
+	{
+	public:
+		explicit LaunchScope(const CommandListener* proxy)
+		{
+			tl_launchingProxies.push_back(proxy);
+		}
+
+		~LaunchScope()
+		{
+			tl_launchingProxies.pop_back();
+		}
+	private:
+		LaunchScope(const LaunchScope&) = delete;
+		LaunchScope& operator=(const LaunchScope&) = delete;
+	};
 }
 
-void Command::ListenerProxy::CommandSucceeded()
+Command::ListenerProxy::ListenerProxy(Command* command, CommandListener* listener) : m_command(command), m_listener(listener)
 {
-	if (std::this_thread::get_id() == m_asyncExeThreadId)
+}
+
+void Command::ListenerProxy::CheckNotLaunching(const char* callbackName) const
+{
+	if (std::find(tl_launchingProxies.begin(), tl_launchingProxies.end(), this) != tl_launchingProxies.end())
 	{
-		throw std::logic_error("CommandListener::CommandSucceeded() was called on the same thread as Command::AsyncExecute()");
+		throw std::logic_error(std::string("CommandListener::") + callbackName + "() was called on the same thread as Command::AsyncExecute()");
 	}
+}
 
+void Command::ListenerProxy::CommandSucceeded()
+{
+	CheckNotLaunching("CommandSucceeded");
 	m_command->DecrementExecuting(m_listener, nullptr, nullptr);
 	delete this;
 }
 
 void Command::ListenerProxy::CommandAborted()
 {
-	if (std::this_thread::get_id() == m_asyncExeThreadId)
-	{
-		throw std::logic_error("CommandListener::CommandAborted() was called on the same thread as Command::AsyncExecute()");
-	}
-
+	CheckNotLaunching("CommandAborted");
 	CommandAbortedException exc;
 	m_command->DecrementExecuting(m_listener, &exc, std::make_exception_ptr(exc));
 	delete this;
@@ -32,11 +59,7 @@ void Command::ListenerProxy::CommandAborted()
 
 void Command::ListenerProxy::CommandFailed(const std::exception& exc, std::exception_ptr excPtr)
 {
-	if (std::this_thread::get_id() == m_asyncExeThreadId)
-	{
-		throw std::logic_error("CommandListener::CommandFailed() was called on the same thread as Command::AsyncExecute()");
-	}
-
+	CheckNotLaunching("CommandFailed");
 	m_command->DecrementExecuting(m_listener, &exc, excPtr);
 	delete this;
 }
@@ -120,7 +143,12 @@ void Command::AsyncExecute(CommandListener* listener)
     {
 		InformCommandStarting();
 		std::unique_ptr<CommandListener> proxy(new ListenerProxy(this, listener));
-        AsyncExecuteImpl(proxy.get());
+
+		{
+			LaunchScope launchScope(proxy.get());
+			AsyncExecuteImpl(proxy.get());
+		}
+
 		proxy.release(); // The proxy commits suicide in its event callbacks
     }
     catch (std::exception& exc)
@@ -173,6 +201,38 @@ Waitable::Ptr Command::AbortEvent() const
 	return m_abortEvent;
 }
 
+void Command::SetExecutor(Executor::Ptr executor)
+{
+	if (m_owner != nullptr)
+	{
+		throw std::logic_error("SetExecutor can only be called on top-level commands. Owned commands use the executor of their top-level command.");
+	}
+
+	std::unique_lock<std::mutex> lock(m_executorMutex);
+	m_executor = executor;
+}
+
+Executor::Ptr Command::GetExecutor() const
+{
+	const Command* topLevel = this;
+
+	while (topLevel->m_owner != nullptr)
+	{
+		topLevel = topLevel->m_owner;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(topLevel->m_executorMutex);
+
+		if (topLevel->m_executor)
+		{
+			return topLevel->m_executor;
+		}
+	}
+
+	return ThreadPool::Default();
+}
+
 Command::Command()
 {
 	m_abortEvent.reset(new Event(false));
@@ -1,155 +1,1372 @@
 ﻿#include "CommandDispatcher.h"
 #include "CommandAbortedException.h"
+#include "BacklogFullException.h"
+#include "CommandTimeoutException.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <thread>
 
 using namespace CommandLib;
 
-CommandDispatcher::CommandDispatcher(size_t maxConcurrent) : m_maxConcurrent(maxConcurrent), m_nothingToDoEvent(true)
+namespace
+{
+	// More shards than this would only spread the running commands thinly, making Abort() slower for no benefit
+	const size_t sm_maxShards = 64;
+
+	// With an adaptive limit, the fastest execution time is forgotten at this rate (a fraction of the difference from each newer
+	// time), so that a lasting change in the downstream service eventually becomes the new normal
+	const double sm_baselineDecay = 0.001;
+
+	// Execution times are smoothed at this rate before being compared to the fastest, so that one slow command cuts nothing
+	const double sm_smoothing = 0.1;
+
+	// The fraction of the adaptive limit kept upon a cut
+	const double sm_backoff = 0.9;
+
+	// Rounded up, so that a timer set for the result finds the time passed
+	long long MillisecondsUntil(std::chrono::steady_clock::time_point due, std::chrono::steady_clock::time_point now)
+	{
+		return due <= now ? 0 : std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count() + 1;
+	}
+}
+
+CommandDispatcher::CommandDispatcher(size_t maxConcurrent) : CommandDispatcher(maxConcurrent, Executor::Ptr())
+{
+}
+
+CommandDispatcher::CommandDispatcher(size_t maxConcurrent, Executor::Ptr executor)
+	: m_maxConcurrent(maxConcurrent), m_executor(executor), m_runningCount(0), m_limit(maxConcurrent), m_adaptive(false),
+	m_outstandingCount(0),
+	m_nothingToDoEvent(true), m_backlogCount(0), m_rateLimited(false)
 {
     if (m_maxConcurrent == 0)
     {
         throw std::invalid_argument("maxConcurrent must be greater than 0");
     }
+
+	const size_t shardCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), sm_maxShards));
+
+	for (size_t i = 0; i < shardCount; ++i)
+	{
+		m_shards.emplace_back(new Shard());
+	}
+}
+
+void CommandDispatcher::AddMonitor(CommandMonitor* monitor)
+{
+	m_monitors.push_back(monitor);
+}
+
+void CommandDispatcher::SetAgingInterval(long long intervalMS)
+{
+	if (intervalMS < 0)
+	{
+		throw std::invalid_argument("intervalMS must not be negative");
+	}
+
+	std::unique_lock<std::mutex> lock(m_backlogMutex);
+	m_agingIntervalMS = intervalMS;
+}
+
+void CommandDispatcher::SetAdaptiveConcurrency(size_t minConcurrent, size_t maxConcurrent, double latencyTolerance)
+{
+	if (minConcurrent == 0)
+	{
+		throw std::invalid_argument("minConcurrent must be greater than 0");
+	}
+
+	if (maxConcurrent < minConcurrent)
+	{
+		throw std::invalid_argument("maxConcurrent must be no less than minConcurrent");
+	}
+
+	if (!(latencyTolerance > 1))
+	{
+		throw std::invalid_argument("latencyTolerance must be greater than 1");
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_limitMutex);
+		m_minLimit = minConcurrent;
+		m_maxLimit = maxConcurrent;
+		m_latencyTolerance = latencyTolerance;
+		m_baselineUS = 0;
+		m_smoothedUS = 0;
+		m_increaseCredit = 0;
+		m_lastDecrease = std::chrono::steady_clock::now();
+		m_limit = std::min(std::max(m_maxConcurrent, minConcurrent), maxConcurrent);
+		m_adaptive = true;
+	}
+
+	// The limit may have risen
+	Pump();
+}
+
+size_t CommandDispatcher::ConcurrencyLimit() const
+{
+	return m_limit;
+}
+
+DispatchHandle CommandDispatcher::Dispatch(Command::Ptr command)
+{
+	return Dispatch(command, 0);
+}
+
+DispatchHandle CommandDispatcher::Dispatch(Command::Ptr command, int priority)
+{
+	DispatchOptions options;
+	options.priority = priority;
+	return Dispatch(command, options);
+}
+
+bool CommandDispatcher::TryDispatch(Command::Ptr command, int priority)
+{
+	DispatchOptions options;
+	options.priority = priority;
+	return TryDispatch(command, options);
+}
+
+bool CommandDispatcher::Dispatch(Command::Ptr command, int priority, long long timeoutMS)
+{
+	DispatchOptions options;
+	options.priority = priority;
+	return Dispatch(command, options, timeoutMS);
+}
+
+DispatchHandle CommandDispatcher::Dispatch(Command::Ptr command, const DispatchOptions& options)
+{
+	// The handle refers to the command weakly, so that holding on to it does not keep the command alive
+	HandleState handle = std::make_shared<DispatchHandle::State>();
+	handle->command = command;
+
+	if (!DispatchImpl(command, options, -1, handle))
+	{
+		throw BacklogFullException();
+	}
+
+	return DispatchHandle(handle);
+}
+
+bool CommandDispatcher::TryDispatch(Command::Ptr command, const DispatchOptions& options)
+{
+	return DispatchImpl(command, options, 0, HandleState());
+}
+
+bool CommandDispatcher::Dispatch(Command::Ptr command, const DispatchOptions& options, long long timeoutMS)
+{
+	return DispatchImpl(command, options, timeoutMS < 0 ? 0 : timeoutMS, HandleState());
+}
+
+void CommandDispatcher::SetRateLimit(double startsPerSecond, double burst)
+{
+	std::unique_ptr<TokenBucket> bucket = CreateBucket(startsPerSecond, burst);
+
+	{
+		std::unique_lock<std::mutex> lock(m_backlogMutex);
+		m_rateBucket = std::move(bucket);
+		m_rateLimited = m_rateBucket || !m_tagBuckets.empty();
+	}
+
+	// The limit may have been raised
+	Pump();
+}
+
+void CommandDispatcher::SetRateLimit(const std::string& tag, double startsPerSecond, double burst)
+{
+	std::unique_ptr<TokenBucket> bucket = CreateBucket(startsPerSecond, burst);
+
+	{
+		std::unique_lock<std::mutex> lock(m_backlogMutex);
+
+		if (bucket)
+		{
+			m_tagBuckets[tag] = std::move(bucket);
+		}
+		else
+		{
+			m_tagBuckets.erase(tag);
+		}
+
+		m_rateLimited = m_rateBucket || !m_tagBuckets.empty();
+	}
+
+	Pump();
+}
+
+void CommandDispatcher::SetTagWeight(const std::string& tag, double weight)
+{
+	if (!(weight > 0))
+	{
+		throw std::invalid_argument("weight must be greater than 0");
+	}
+
+	std::unique_lock<std::mutex> lock(m_backlogMutex);
+	m_tagWeights[tag] = weight;
+	auto flow = m_flows.find(tag);
+
+	if (flow != m_flows.end())
+	{
+		flow->second.weight = weight;
+	}
+}
+
+std::unique_ptr<TokenBucket> CommandDispatcher::CreateBucket(double startsPerSecond, double burst)
+{
+	if (startsPerSecond < 0)
+	{
+		throw std::invalid_argument("startsPerSecond must not be negative");
+	}
+
+	return startsPerSecond == 0 ? std::unique_ptr<TokenBucket>() : std::unique_ptr<TokenBucket>(new TokenBucket(startsPerSecond, burst));
+}
+
+void CommandDispatcher::SetBacklogLimit(size_t maxBacklog, OverflowPolicy policy)
+{
+	std::unique_lock<std::mutex> lock(m_backlogMutex);
+	m_maxBacklog = maxBacklog;
+	m_overflowPolicy = policy;
+	m_backlogRoom.notify_all();
+}
+
+void CommandDispatcher::SetBacklogWatermarks(size_t lowWatermark, size_t highWatermark)
+{
+	if (lowWatermark >= highWatermark)
+	{
+		throw std::invalid_argument("highWatermark must be greater than lowWatermark");
+	}
+
+	std::unique_lock<std::mutex> lock(m_backlogMutex);
+	m_lowWatermark = lowWatermark;
+	m_highWatermark = highWatermark;
+	UpdateWatermarks();
+}
+
+Waitable::Ptr CommandDispatcher::BacklogHighEvent() const
+{
+	return m_backlogHighEvent;
+}
+
+Waitable::Ptr CommandDispatcher::BacklogLowEvent() const
+{
+	return m_backlogLowEvent;
+}
+
+bool CommandDispatcher::DispatchImpl(Command::Ptr command, const DispatchOptions& options, long long timeoutMS, const HandleState& handle)
+{
+	// A negative timeout means wait as long as it takes
+    if (command->Parent() != nullptr)
+    {
+        throw std::invalid_argument("Only top-level commands can be dispatched");
+    }
+
+	if (m_executor)
+	{
+		command->SetExecutor(m_executor);
+	}
+
+	if (!options.lane.empty())
+	{
+		std::unique_lock<std::mutex> lock(m_laneMutex);
+		auto lane = m_lanes.find(options.lane);
+
+		if (lane != m_lanes.end())
+		{
+			// Another command of this lane is ahead. This one is admitted once that one has finished.
+			AddOutstanding();
+			lane->second.push_back({ command, options, handle });
+			return true;
+		}
+
+		m_lanes.emplace(options.lane, std::deque<LanedCommand>());
+	}
+
+	Admission admission;
+
+	try
+	{
+		admission = Admit(command, options, timeoutMS, false, handle);
+	}
+	catch (...)
+	{
+		AdvanceLane(options.lane);
+		throw;
+	}
+
+	if (admission != Admission::Accepted)
+	{
+		AdvanceLane(options.lane);
+	}
+
+	return admission != Admission::Rejected;
+}
+
+CommandDispatcher::Admission CommandDispatcher::Admit(
+	Command::Ptr command, const DispatchOptions& options, long long timeoutMS, bool bypassLimit, const HandleState& handle)
+{
+	// Puts the command into the backlog, or starts it. A negative timeout means wait as long as it takes.
+	if (handle && handle->cancelled)
+	{
+		ReportCancelled(*command, handle);
+		return Admission::Discarded;
+	}
+
+	if (options.deadline != std::chrono::steady_clock::time_point::max() && options.deadline <= std::chrono::steady_clock::now())
+	{
+		ReportExpired(*command, handle);
+		return Admission::Discarded;
+	}
+
+	AddOutstanding();
+
+	// Nothing is shared with other dispatching threads unless the pool is full, commands are already waiting for room (in
+	// which case they go first), or start rates are limited
+	if (m_backlogCount == 0 && !m_rateLimited && TryAcquireSlot())
+	{
+		std::unique_ptr<Listener> listener(new Listener(this, command, options.lane, handle));
+
+		try
+		{
+			Launch(listener.get());
+			listener.release();
+		}
+		catch (...)
+		{
+			--m_runningCount;
+			Pump();
+			RemoveOutstanding(1);
+			throw;
+		}
+
+		// The command may have been cancelled while it started, in which case the abort may have been undone by the start
+		if (handle && handle->cancelled)
+		{
+			command->Abort();
+		}
+
+		return Admission::Accepted;
+	}
+
+	QueuedCommand dropped;
+	std::vector<QueuedCommand> expired;
+
+	{
+		std::unique_lock<std::mutex> lock(m_backlogMutex);
+		auto isRoom = [this]() { return m_maxBacklog == 0 || m_backlogCount < m_maxBacklog; };
+
+		if (!bypassLimit && !isRoom())
+		{
+			// Commands whose deadlines have passed make room before any live command is dropped or turned away
+			PurgeExpired(std::chrono::steady_clock::now(), expired);
+		}
+
+		if (!bypassLimit && !isRoom())
+		{
+			bool admitted = false;
+
+			if (m_overflowPolicy == OverflowPolicy::DropOldest)
+			{
+				dropped = PopOldest();
+				admitted = true;
+			}
+			else if (m_overflowPolicy == OverflowPolicy::Block && timeoutMS != 0)
+			{
+				++m_blockedDispatchers;
+
+				if (timeoutMS < 0)
+				{
+					m_backlogRoom.wait(lock, isRoom);
+					admitted = true;
+				}
+				else
+				{
+					admitted = m_backlogRoom.wait_for(lock, std::chrono::milliseconds(timeoutMS), isRoom);
+				}
+
+				--m_blockedDispatchers;
+			}
+
+			if (!admitted)
+			{
+				lock.unlock();
+				DiscardExpired(expired);
+				RemoveOutstanding(1);
+				return Admission::Rejected;
+			}
+		}
+
+		auto found = m_flows.find(options.tag);
+
+		if (found == m_flows.end())
+		{
+			found = m_flows.emplace(options.tag, Flow()).first;
+			Flow& flow = found->second;
+			flow.tag = &found->first;
+			auto weight = m_tagWeights.find(options.tag);
+			flow.weight = weight == m_tagWeights.end() ? 1 : weight->second;
+
+			// A newly queued tag waits for its turn like any other
+			flow.position = m_activeFlows.insert(m_activeFlows.end(), &flow);
+		}
+
+		found->second.levels[options.priority].Push(
+			{ command, std::chrono::steady_clock::now(), m_nextSequence++, options.deadline, options.lane, handle });
+		++m_backlogCount;
+		UpdateWatermarks();
+
+		if (options.deadline != std::chrono::steady_clock::time_point::max())
+		{
+			// Expiry is reported when the deadline passes, rather than whenever there is next room in the pool
+			m_earliestDeadline = std::min(m_earliestDeadline, options.deadline);
+			ScheduleRelease(MillisecondsUntil(options.deadline, std::chrono::steady_clock::now()));
+		}
+	}
+
+	DiscardExpired(expired);
+
+	if (dropped.command)
+	{
+		CommandAbortedException exc("Dropped from a full backlog");
+		ReportFinished(*dropped.command, dropped.handle, &exc, std::make_exception_ptr(exc));
+		AdvanceLane(dropped.lane);
+		RemoveOutstanding(1);
+	}
+
+	// Room may have become available since the check above, in which case nobody else is going to notice the queued command
+	Pump();
+	return Admission::Accepted;
+}
+
+void CommandDispatcher::AdvanceLane(const std::string& lane)
+{
+	// A command of this lane has left the dispatcher (or was never let in), so the next one in the lane may be admitted. The
+	// lane is removed once nothing of it is left.
+	if (lane.empty())
+	{
+		return;
+	}
+
+	while (true)
+	{
+		LanedCommand next;
+
+		{
+			std::unique_lock<std::mutex> lock(m_laneMutex);
+			auto found = m_lanes.find(lane);
+
+			if (found == m_lanes.end())
+			{
+				return; // cleared by Abort()
+			}
+
+			if (found->second.empty())
+			{
+				m_lanes.erase(found);
+				return;
+			}
+
+			next = std::move(found->second.front());
+			found->second.pop_front();
+		}
+
+		// The command was counted as outstanding while it waited in the lane. It is admitted without waiting for room, since
+		// it was accepted when dispatched.
+		Admission admission = Admission::Discarded;
+
+		try
+		{
+			admission = Admit(next.command, next.options, -1, true, next.handle);
+		}
+		catch (std::exception& exc)
+		{
+			ReportFinished(*next.command, next.handle, &exc, std::current_exception());
+		}
+
+		RemoveOutstanding(1);
+
+		if (admission == Admission::Accepted)
+		{
+			return;
+		}
+	}
+}
+
+void CommandDispatcher::Abort()
+{
+	size_t cleared = 0;
+	std::vector<std::string> clearedLanes;
+
+	// The discarded commands are not reported to the monitors, but whoever holds their handles must learn what became of them
+	std::vector<HandleState> clearedHandles;
+
+	{
+		std::unique_lock<std::mutex> lock(m_backlogMutex);
+
+		for (const auto& flow : m_flows)
+		{
+			for (const auto& level : flow.second.levels)
+			{
+				cleared += level.second.Size();
+
+				for (const QueuedCommand& queued : level.second.dated)
+				{
+					clearedLanes.push_back(queued.lane);
+					clearedHandles.push_back(queued.handle);
+				}
+
+				for (const QueuedCommand& queued : level.second.undated)
+				{
+					clearedLanes.push_back(queued.lane);
+					clearedHandles.push_back(queued.handle);
+				}
+			}
+		}
+
+		m_activeFlows.clear();
+		m_flows.clear();
+		m_backlogCount -= cleared;
+		m_earliestDeadline = std::chrono::steady_clock::time_point::max();
+		UpdateWatermarks();
+		m_backlogRoom.notify_all();
+
+		if (CancelRelease())
+		{
+			++cleared; // the timer's hold upon this object
+		}
+	}
+
+	{
+		// The commands waiting in lanes are discarded too. A lane whose current command was in the backlog is gone entirely;
+		// one whose current command is running stays until that command finishes, so that nothing new overtakes it.
+		std::unique_lock<std::mutex> lock(m_laneMutex);
+
+		for (auto& lane : m_lanes)
+		{
+			cleared += lane.second.size();
+
+			for (const LanedCommand& laned : lane.second)
+			{
+				clearedHandles.push_back(laned.handle);
+			}
+
+			lane.second.clear();
+		}
+
+		for (const std::string& lane : clearedLanes)
+		{
+			if (!lane.empty())
+			{
+				m_lanes.erase(lane);
+			}
+		}
+	}
+
+	for (const std::unique_ptr<Shard>& shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(shard->mutex);
+
+		for (Listener* listener = shard->running; listener != nullptr; listener = listener->m_next)
+		{
+			listener->m_command->Abort();
+		}
+	}
+
+	CommandAbortedException exc;
+	const std::exception_ptr excPtr = std::make_exception_ptr(exc);
+
+	for (const HandleState& handle : clearedHandles)
+	{
+		if (handle)
+		{
+			handle->Complete(&exc, excPtr);
+		}
+	}
+
+	RemoveOutstanding(cleared);
+}
+
+void CommandDispatcher::Wait()
+{
+	m_nothingToDoEvent.Wait();
+}
+
+void CommandDispatcher::AbortAndWait()
+{
+    Abort();
+    Wait();
+}
+
+CommandDispatcher::~CommandDispatcher()
+{
+	Wait();
+
+	// The thread that signaled the event may still be holding this mutex
+	std::unique_lock<std::mutex> lock(m_idleMutex);
+}
+
+bool CommandDispatcher::TryAcquireSlot()
+{
+	size_t running = m_runningCount;
+
+	while (running < m_limit)
+	{
+		if (m_runningCount.compare_exchange_weak(running, running + 1))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CommandDispatcher::Launch(Listener* listener)
+{
+	// The caller has acquired a slot for the command. It is tracked before it starts, so that Abort() can find it.
+	static std::atomic_size_t nextShard(0);
+	thread_local const size_t tl_shard = nextShard++;
+	listener->m_shard = tl_shard % m_shards.size();
+
+	if (m_adaptive)
+	{
+		listener->m_startTime = std::chrono::steady_clock::now();
+	}
+
+	Shard& shard = *m_shards[listener->m_shard];
+
+	{
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		listener->m_next = shard.running;
+
+		if (shard.running != nullptr)
+		{
+			shard.running->m_previous = listener;
+		}
+
+		shard.running = listener;
+	}
+
+	try
+	{
+		listener->m_command->AsyncExecute(listener);
+	}
+	catch (...)
+	{
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		Unlink(shard, listener);
+		throw;
+	}
+}
+
+void CommandDispatcher::Unlink(Shard& shard, Listener* listener)
+{
+	// The caller holds the shard's mutex
+	if (listener->m_previous != nullptr)
+	{
+		listener->m_previous->m_next = listener->m_next;
+	}
+	else
+	{
+		shard.running = listener->m_next;
+	}
+
+	if (listener->m_next != nullptr)
+	{
+		listener->m_next->m_previous = listener->m_previous;
+	}
+
+	listener->m_previous = nullptr;
+	listener->m_next = nullptr;
+}
+
+void CommandDispatcher::Pump()
+{
+	// Admitting the next command of a lane may call back into this method. The outer call carries on regardless, so the inner
+	// one is skipped, lest a run of expired commands nest these calls deeply.
+	thread_local const CommandDispatcher* tl_pumping = nullptr;
+
+	if (tl_pumping == this)
+	{
+		return;
+	}
+
+	// Restored however this method is left, lest an exception from a monitor leave this thread unable to pump ever again
+	struct PumpingScope
+	{
+		const CommandDispatcher*& pumping;
+		const CommandDispatcher* const outer;
+		~PumpingScope() { pumping = outer; }
+	} scope{ tl_pumping, tl_pumping };
+
+	tl_pumping = this;
+
+	while (m_backlogCount > 0 && TryAcquireSlot())
+	{
+		QueuedCommand next;
+		std::vector<QueuedCommand> expired;
+		bool popped;
+		size_t released = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(m_backlogMutex);
+			long long retryMS = -1;
+			popped = PopBacklog(next, retryMS, expired);
+			m_backlogCount -= expired.size() + (popped ? 1 : 0);
+			UpdateWatermarks();
+
+			if (m_backlogCount == 0)
+			{
+				// A timer armed for a deadline must not keep this object waiting once there is nothing left to expire
+				m_earliestDeadline = std::chrono::steady_clock::time_point::max();
+				released = CancelRelease() ? 1 : 0;
+			}
+
+			if (m_blockedDispatchers > 0)
+			{
+				m_backlogRoom.notify_all();
+			}
+
+			if (!popped)
+			{
+				// The backlog was emptied by another thread or by Abort(), or whatever is left must wait for the start rate
+				--m_runningCount;
+
+				if (retryMS >= 0)
+				{
+					ScheduleRelease(retryMS);
+				}
+			}
+		}
+
+		DiscardExpired(expired);
+		RemoveOutstanding(released);
+
+		if (!popped)
+		{
+			if (expired.empty())
+			{
+				break;
+			}
+
+			continue; // the lanes may have queued more
+		}
+
+		if (next.handle && next.handle->cancelled)
+		{
+			ReportCancelled(*next.command, next.handle);
+			--m_runningCount;
+			AdvanceLane(next.lane);
+			RemoveOutstanding(1);
+			continue;
+		}
+
+		std::unique_ptr<Listener> listener(new Listener(this, next.command, next.lane, next.handle));
+
+		try
+		{
+			Launch(listener.get());
+			listener.release();
+
+			if (next.handle && next.handle->cancelled)
+			{
+				next.command->Abort();
+			}
+		}
+		catch (std::exception& exc)
+		{
+			ReportFinished(*next.command, next.handle, &exc, std::current_exception());
+			--m_runningCount;
+			AdvanceLane(next.lane);
+			RemoveOutstanding(1);
+		}
+	}
+}
+
+void CommandDispatcher::OnCommandFinished(Listener* listener, const std::exception* exc, std::exception_ptr excPtr)
+{
+	ReportFinished(*listener->m_command, listener->m_handle, exc, excPtr);
+
+	AdjustLimit(listener, exc);
+
+	{
+		Shard& shard = *m_shards[listener->m_shard];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		Unlink(shard, listener);
+
+		// We cannot dispose of this command here, because it's not quite done executing yet. Those finished before it most
+		// likely are by now, so retention stays bounded.
+		while (!shard.finished.empty() && shard.finished.front()->DoneEvent()->IsSignaled())
+		{
+			shard.finished.pop_front();
+		}
+
+		shard.finished.push_back(std::move(listener->m_command));
+	}
+
+	--m_runningCount;
+	AdvanceLane(listener->m_lane);
+	Pump();
+
+	// This must be the last use of this object, since waiters may destroy it as soon as nothing is left to do
+	RemoveOutstanding(1);
+}
+
+void CommandDispatcher::AddOutstanding()
+{
+	if (m_outstandingCount++ == 0)
+	{
+		// The count is checked again under the lock, in case the last command finished (and tried to set the event) in between
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+
+		if (m_outstandingCount != 0)
+		{
+			m_nothingToDoEvent.Reset();
+		}
+	}
 }
 
-void CommandDispatcher::AddMonitor(CommandMonitor* monitor)
+void CommandDispatcher::RemoveOutstanding(size_t count)
 {
-	m_monitors.push_back(monitor);
+	if (count > 0 && (m_outstandingCount -= count) == 0)
+	{
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+
+		if (m_outstandingCount == 0)
+		{
+			m_nothingToDoEvent.Set();
+		}
+	}
 }
 
-void CommandDispatcher::Dispatch(Command::Ptr command)
+bool CommandDispatcher::PopBacklog(QueuedCommand& next, long long& retryMS, std::vector<QueuedCommand>& expired)
 {
-    if (command->Parent() != nullptr)
-    {
-        throw std::invalid_argument("Only top-level commands can be dispatched");
-    }
+	// The caller holds m_backlogMutex. If nothing may start now only because of the start rate, retryMS is set to the number of
+	// milliseconds until something may. Commands found to have missed their deadlines are moved to expired.
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if (m_activeFlows.empty())
+	{
+		return false;
+	}
 
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_nothingToDoEvent.Reset();
-	m_finishedCommands.clear();
+	if (m_rateBucket && !m_rateBucket->IsAvailable(now))
+	{
+		retryMS = m_rateBucket->MillisecondsUntilAvailable(now);
+		return false;
+	}
 
-    if (m_runningCommands.size() == m_maxConcurrent)
-    {
-        m_commandBacklog.push(command);
-    }
-    else
-    {
-        m_runningCommands.push_back(command);
-		std::unique_ptr<Listener> listener(new Listener(this, command));
-		lock.unlock();
+	// Deficit round robin. The flow at the front starts commands while its deficit lasts, and then goes to the back of the line,
+	// to be topped up by its weight when it next comes around. Flows held back by their rates are passed over.
+	size_t blocked = 0;
 
-		try
+	while (blocked < m_activeFlows.size())
+	{
+		Flow* flow = m_activeFlows.front();
+		TokenBucket* bucket = nullptr;
+
+		if (RemoveExpired(flow, now, expired))
 		{
-			command->AsyncExecute(listener.get());
-			listener.release();
+			continue; // nothing else was queued with this tag
 		}
-		catch(...)
+
+		if (!m_tagBuckets.empty())
 		{
-			lock.lock();
-			m_runningCommands.erase(std::remove(m_runningCommands.begin(), m_runningCommands.end(), command), m_runningCommands.end());
+			auto found = m_tagBuckets.find(*flow->tag);
 
-			if (m_runningCommands.empty() && m_commandBacklog.empty())
+			if (found != m_tagBuckets.end())
 			{
-				lock.unlock();
-				m_nothingToDoEvent.Set();
+				bucket = found->second.get();
+
+				if (!bucket->IsAvailable(now))
+				{
+					const long long waitMS = bucket->MillisecondsUntilAvailable(now);
+					retryMS = retryMS < 0 ? waitMS : std::min(retryMS, waitMS);
+					m_activeFlows.splice(m_activeFlows.end(), m_activeFlows, m_activeFlows.begin());
+					++blocked;
+					continue;
+				}
 			}
+		}
 
-			throw;
+		if (flow->deficit < 1)
+		{
+			flow->deficit += flow->weight;
+			m_activeFlows.splice(m_activeFlows.end(), m_activeFlows, m_activeFlows.begin());
+			blocked = 0;
+			continue;
 		}
-    }
+
+		retryMS = -1;
+
+		if (m_rateBucket)
+		{
+			m_rateBucket->TryTake(now);
+		}
+
+		if (bucket != nullptr)
+		{
+			bucket->TryTake(now);
+		}
+
+		long long priority;
+		auto level = MostUrgentLevel(flow->levels, now, priority);
+		next = level->second.Front(m_agingIntervalMS);
+		level->second.PopFront(m_agingIntervalMS);
+		flow->deficit -= 1;
+
+		if (level->second.Empty())
+		{
+			flow->levels.erase(level);
+
+			if (flow->levels.empty())
+			{
+				RemoveFlow(flow);
+			}
+		}
+
+		return true;
+	}
+
+	return false;
 }
 
-void CommandDispatcher::Abort()
+void CommandDispatcher::RemoveFlow(Flow* flow)
+{
+	// The caller holds m_backlogMutex. A flow that empties forfeits whatever deficit it had left, as in any round robin.
+	m_activeFlows.erase(flow->position);
+	m_flows.erase(m_flows.find(*flow->tag));
+}
+
+bool CommandDispatcher::RemoveExpired(Flow* flow, std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-    
-	while (!m_commandBacklog.empty())
+	// The caller holds m_backlogMutex. Within each level, any expired commands are first in line. Returns true if this leaves
+	// the flow empty, in which case it is removed.
+	for (auto level = flow->levels.begin(); level != flow->levels.end();)
 	{
-		m_commandBacklog.pop();
+		level->second.RemoveExpired(now, expired);
+		level = level->second.Empty() ? flow->levels.erase(level) : std::next(level);
 	}
 
-	for (Command::Ptr cmd : m_runningCommands)
-    {
-        cmd->Abort();
-    }
+	if (flow->levels.empty())
+	{
+		RemoveFlow(flow);
+		return true;
+	}
+
+	return false;
 }
 
-void CommandDispatcher::Wait()
+void CommandDispatcher::PurgeExpired(std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired)
 {
-	m_nothingToDoEvent.Wait();
+	// The caller holds m_backlogMutex. Removes the expired commands of every flow, not only of the one whose turn it is, and
+	// arms the release timer for the next deadline, so that expiry is noticed on time even while the pool stays full.
+	if (m_backlogCount == 0)
+	{
+		m_earliestDeadline = std::chrono::steady_clock::time_point::max();
+		return;
+	}
+
+	if (now < m_earliestDeadline)
+	{
+		if (m_earliestDeadline != std::chrono::steady_clock::time_point::max())
+		{
+			// The timer may have been taken over by an earlier start-rate release
+			ScheduleRelease(MillisecondsUntil(m_earliestDeadline, now));
+		}
+
+		return;
+	}
+
+	const size_t previouslyExpired = expired.size();
+	std::chrono::steady_clock::time_point earliest = std::chrono::steady_clock::time_point::max();
+
+	for (auto it = m_activeFlows.begin(); it != m_activeFlows.end();)
+	{
+		Flow* flow = *it++;
+
+		if (!RemoveExpired(flow, now, expired))
+		{
+			for (const auto& level : flow->levels)
+			{
+				if (!level.second.dated.empty())
+				{
+					earliest = std::min(earliest, level.second.dated.begin()->deadline);
+				}
+			}
+		}
+	}
+
+	m_earliestDeadline = earliest;
+	m_backlogCount -= expired.size() - previouslyExpired;
+	UpdateWatermarks();
+
+	if (m_blockedDispatchers > 0)
+	{
+		m_backlogRoom.notify_all();
+	}
+
+	if (earliest != std::chrono::steady_clock::time_point::max())
+	{
+		ScheduleRelease(MillisecondsUntil(earliest, now));
+	}
 }
 
-void CommandDispatcher::AbortAndWait()
+void CommandDispatcher::DiscardExpired(const std::vector<QueuedCommand>& expired)
 {
-    Abort();
-    Wait();
+	for (const QueuedCommand& queued : expired)
+	{
+		ReportExpired(*queued.command, queued.handle);
+		AdvanceLane(queued.lane);
+	}
+
+	RemoveOutstanding(expired.size());
 }
 
-CommandDispatcher::~CommandDispatcher()
+void CommandDispatcher::ReportFinished(const Command& command, const HandleState& handle, const std::exception* exc, std::exception_ptr excPtr)
 {
-	Wait();
+	for (CommandLib::CommandMonitor* monitor : m_monitors)
+	{
+		monitor->CommandFinished(command, exc);
+	}
+
+	if (handle)
+	{
+		handle->Complete(exc, excPtr);
+	}
 }
 
-void CommandDispatcher::OnCommandFinished(Command::Ptr command, const std::exception* exc)
+void CommandDispatcher::ReportExpired(const Command& command, const HandleState& handle)
 {
-	for (CommandLib::CommandMonitor* monitor : m_monitors)
-    {
-        monitor->CommandFinished(*command, exc);
-    }
+	CommandTimeoutException exc("The deadline passed before the command started");
+	ReportFinished(command, handle, &exc, std::make_exception_ptr(exc));
+}
 
-	std::unique_lock<std::mutex> lock(m_mutex);
-    m_runningCommands.erase(std::remove(m_runningCommands.begin(), m_runningCommands.end(), command), m_runningCommands.end());
+void CommandDispatcher::ReportCancelled(const Command& command, const HandleState& handle)
+{
+	CommandAbortedException exc("Cancelled before the command started");
+	ReportFinished(command, handle, &exc, std::make_exception_ptr(exc));
+}
 
-    // We cannot dispose of this command here, because it's not quite done executing yet.
-    m_finishedCommands.push_back(command);
+CommandDispatcher::PriorityLevels::iterator CommandDispatcher::MostUrgentLevel(
+	PriorityLevels& levels, std::chrono::steady_clock::time_point now, long long& priority)
+{
+	// A level is as urgent as the command in it that has waited longest, which need not be the one that would start first
+	auto next = levels.begin();
+	priority = next->first;
 
-    if (m_commandBacklog.empty())
-    {
-        if (m_runningCommands.empty())
-        {
-			lock.unlock();
-			m_nothingToDoEvent.Set();
-        }
-    }
-    else
-    {
-        Command::Ptr nextInLine = m_commandBacklog.front();
-		m_commandBacklog.pop();
-        m_runningCommands.push_back(nextInLine);
-		std::unique_ptr<Listener> listener(new Listener(this, nextInLine));
-		lock.unlock();
+	if (m_agingIntervalMS > 0)
+	{
+		for (auto it = levels.begin(); it != levels.end(); ++it)
+		{
+			const long long waitedMS = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second.Oldest().queuedTime).count();
+			const long long agedPriority = it->first + waitedMS / m_agingIntervalMS;
 
-		try
+			// Upon a tie, the level that is more urgent to begin with wins, since it comes first
+			if (it == levels.begin() || agedPriority > priority)
+			{
+				next = it;
+				priority = agedPriority;
+			}
+		}
+	}
+
+	return next;
+}
+
+CommandDispatcher::QueuedCommand CommandDispatcher::PopOldest()
+{
+	// The caller holds m_backlogMutex, and the backlog is not empty
+	Flow* oldestFlow = m_activeFlows.front();
+	auto oldest = oldestFlow->levels.begin();
+
+	for (Flow* flow : m_activeFlows)
+	{
+		for (auto it = flow->levels.begin(); it != flow->levels.end(); ++it)
+		{
+			if (it->second.Oldest().sequence < oldest->second.Oldest().sequence)
+			{
+				oldestFlow = flow;
+				oldest = it;
+			}
+		}
+	}
+
+	QueuedCommand queued = oldest->second.Oldest();
+	oldest->second.PopOldest();
+
+	if (oldest->second.Empty())
+	{
+		oldestFlow->levels.erase(oldest);
+
+		if (oldestFlow->levels.empty())
+		{
+			RemoveFlow(oldestFlow);
+		}
+	}
+
+	--m_backlogCount;
+	return queued;
+}
+
+void CommandDispatcher::ScheduleRelease(long long ms)
+{
+	// The caller holds m_backlogMutex. One timer at a time is enough: whichever is due soonest.
+	const std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+	if (m_releaseTimerId != 0)
+	{
+		if (m_releaseDue <= due)
 		{
-			nextInLine->AsyncExecute(listener.get());
+			return;
 		}
-		catch (std::exception exc)
+
+		if (TimerService::Default()->Cancel(m_releaseTimerId))
 		{
-			OnCommandFinished(nextInLine, &exc);
+			RemoveOutstanding(1);
 		}
+	}
 
-		listener.release();
-    }
+	// The timer counts as outstanding work, so that this object is not destroyed before the timer is done with it. There are
+	// commands in the backlog, so this is never the first outstanding item.
+	AddOutstanding();
+	const unsigned long long generation = ++m_releaseGeneration;
+	m_releaseDue = due;
+	m_releaseTimerId = TimerService::Default()->Schedule(ms, [this, generation]() { OnReleaseTimer(generation); });
+}
+
+bool CommandDispatcher::CancelRelease()
+{
+	// The caller holds m_backlogMutex. Returns true if the timer will not fire, in which case its hold upon this object passes
+	// to the caller.
+	if (m_releaseTimerId != 0 && TimerService::Default()->Cancel(m_releaseTimerId))
+	{
+		m_releaseTimerId = 0;
+		return true;
+	}
+
+	return false;
+}
+
+void CommandDispatcher::OnReleaseTimer(unsigned long long generation)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_backlogMutex);
+
+		if (generation == m_releaseGeneration)
+		{
+			m_releaseTimerId = 0;
+		}
+	}
+
+	// Pumping launches commands and informs the monitors, which is no work for the timer thread. The timer's hold upon this
+	// object passes to the handed-off call.
+	const Executor::Ptr executor = m_executor ? m_executor : ThreadPool::Default();
+
+	executor->Execute([this]()
+	{
+		std::vector<QueuedCommand> expired;
+
+		{
+			std::unique_lock<std::mutex> lock(m_backlogMutex);
+			PurgeExpired(std::chrono::steady_clock::now(), expired);
+		}
+
+		DiscardExpired(expired);
+		Pump();
+
+		// This must be the last use of this object
+		RemoveOutstanding(1);
+	});
+}
+
+void CommandDispatcher::UpdateWatermarks()
+{
+	// The caller holds m_backlogMutex
+	if (m_highWatermark == 0)
+	{
+		return;
+	}
+
+	if (m_backlogCount >= m_highWatermark)
+	{
+		m_backlogLowEvent->Reset();
+		m_backlogHighEvent->Set();
+	}
+	else if (m_backlogCount <= m_lowWatermark)
+	{
+		m_backlogHighEvent->Reset();
+		m_backlogLowEvent->Set();
+	}
+}
+
+void CommandDispatcher::AdjustLimit(const Listener* listener, const std::exception* exc)
+{
+	// Commands started before the limit was made adaptive were not timed
+	if (!m_adaptive || listener->m_startTime == std::chrono::steady_clock::time_point())
+	{
+		return;
+	}
+
+	if (exc != nullptr && dynamic_cast<const CommandAbortedException*>(exc) != nullptr)
+	{
+		return; // says nothing about the downstream service
+	}
+
+	const double latencyUS = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - listener->m_startTime).count();
+
+	std::unique_lock<std::mutex> lock(m_limitMutex);
+
+	if (m_baselineUS == 0 || latencyUS < m_baselineUS)
+	{
+		m_baselineUS = latencyUS;
+	}
+	else
+	{
+		m_baselineUS += (latencyUS - m_baselineUS) * sm_baselineDecay;
+	}
+
+	m_smoothedUS = m_smoothedUS == 0 ? latencyUS : m_smoothedUS + (latencyUS - m_smoothedUS) * sm_smoothing;
+	const size_t limit = m_limit;
+
+	if (exc != nullptr || m_smoothedUS > m_baselineUS * m_latencyTolerance)
+	{
+		// Commands started before the last cut were running under the old limit, so they cannot justify another
+		if (listener->m_startTime > m_lastDecrease)
+		{
+			m_lastDecrease = std::chrono::steady_clock::now();
+			m_increaseCredit = 0;
+			m_limit = std::max(m_minLimit, (size_t)(limit * sm_backoff));
+		}
+	}
+	else if (m_runningCount * 2 >= limit && limit < m_maxLimit)
+	{
+		// Raising the limit is pointless unless it is being reached, or nearly so
+		m_increaseCredit += 1.0 / limit;
+
+		if (m_increaseCredit >= 1)
+		{
+			m_increaseCredit = 0;
+			m_limit = limit + 1;
+		}
+	}
+}
+
+bool CommandDispatcher::QueuedCommand::operator<(const QueuedCommand& other) const
+{
+	return deadline != other.deadline ? deadline < other.deadline : sequence < other.sequence;
+}
+
+void CommandDispatcher::PriorityLevel::Push(QueuedCommand&& queued)
+{
+	if (queued.deadline == std::chrono::steady_clock::time_point::max())
+	{
+		undated.push_back(std::move(queued));
+	}
+	else
+	{
+		const unsigned long long sequence = queued.sequence;
+		datedBySequence.emplace(sequence, dated.insert(std::move(queued)).first);
+	}
+}
+
+bool CommandDispatcher::PriorityLevel::UndatedFirst(long long agingIntervalMS) const
+{
+	if (dated.empty())
+	{
+		return true;
+	}
+
+	// Having a deadline is worth one step of aging, so the longest waiting undated command overtakes the earliest deadline
+	// once it has waited an interval longer
+	return agingIntervalMS > 0 && !undated.empty() &&
+		undated.front().queuedTime + std::chrono::milliseconds(agingIntervalMS) <= dated.begin()->queuedTime;
+}
+
+const CommandDispatcher::QueuedCommand& CommandDispatcher::PriorityLevel::Front(long long agingIntervalMS) const
+{
+	return UndatedFirst(agingIntervalMS) ? undated.front() : *dated.begin();
+}
+
+void CommandDispatcher::PriorityLevel::PopFront(long long agingIntervalMS)
+{
+	if (UndatedFirst(agingIntervalMS))
+	{
+		undated.pop_front();
+	}
+	else
+	{
+		EraseDated(dated.begin());
+	}
+}
+
+const CommandDispatcher::QueuedCommand& CommandDispatcher::PriorityLevel::Oldest() const
+{
+	if (dated.empty())
+	{
+		return undated.front();
+	}
+
+	const QueuedCommand& oldestDated = *datedBySequence.begin()->second;
+	return undated.empty() || oldestDated.sequence < undated.front().sequence ? oldestDated : undated.front();
+}
+
+void CommandDispatcher::PriorityLevel::PopOldest()
+{
+	if (dated.empty() || (!undated.empty() && undated.front().sequence < datedBySequence.begin()->first))
+	{
+		undated.pop_front();
+	}
+	else
+	{
+		EraseDated(datedBySequence.begin()->second);
+	}
+}
+
+void CommandDispatcher::PriorityLevel::RemoveExpired(std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired)
+{
+	// Any expired commands are first in deadline order
+	while (!dated.empty() && dated.begin()->deadline <= now)
+	{
+		expired.push_back(*dated.begin());
+		EraseDated(dated.begin());
+	}
+}
+
+void CommandDispatcher::PriorityLevel::EraseDated(std::set<QueuedCommand>::iterator position)
+{
+	datedBySequence.erase(position->sequence);
+	dated.erase(position);
+}
+
+bool CommandDispatcher::PriorityLevel::Empty() const
+{
+	return dated.empty() && undated.empty();
 }
 
-CommandDispatcher::Listener::Listener(CommandDispatcher* dispatcher, Command::Ptr command) : m_dispatcher(dispatcher), m_command(command)
+size_t CommandDispatcher::PriorityLevel::Size() const
+{
+	return dated.size() + undated.size();
+}
+
+CommandDispatcher::Listener::Listener(CommandDispatcher* dispatcher, Command::Ptr command, const std::string& lane, const HandleState& handle)
+	: m_command(command), m_lane(lane), m_handle(handle), m_dispatcher(dispatcher)
 {
 }
 
 void CommandDispatcher::Listener::CommandSucceeded()
 {
-    m_dispatcher->OnCommandFinished(m_command, nullptr);
+    m_dispatcher->OnCommandFinished(this, nullptr, nullptr);
 	delete this;
 }
 
 void CommandDispatcher::Listener::CommandAborted()
 {
 	CommandAbortedException exc;
-	m_dispatcher->OnCommandFinished(m_command, &exc);
+	m_dispatcher->OnCommandFinished(this, &exc, std::make_exception_ptr(exc));
 	delete this;
 }
 
-void CommandDispatcher::Listener::CommandFailed(const std::exception& exc, std::exception_ptr)
+void CommandDispatcher::Listener::CommandFailed(const std::exception& exc, std::exception_ptr excPtr)
 {
-	m_dispatcher->OnCommandFinished(m_command, &exc);
+	m_dispatcher->OnCommandFinished(this, &exc, excPtr);
 	delete this;
-}
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "CoroutineCommand.h"
+#include "CommandAbortedException.h"
+
+using namespace CommandLib;
+
+CommandAwaiter::CommandAwaiter(Command::Ptr command) : m_command(command)
+{
+}
+
+bool CommandAwaiter::await_ready() const noexcept
+{
+	return false;
+}
+
+void CommandAwaiter::await_suspend(std::coroutine_handle<> awaiting)
+{
+	m_awaiting = awaiting;
+
+	// Once launched, the coroutine may be resumed on another thread and this awaiter destroyed before AsyncExecute() returns
+	Command::Ptr command = m_command;
+	command->AsyncExecute(this);
+}
+
+void CommandAwaiter::await_resume() const
+{
+	if (m_exception)
+	{
+		std::rethrow_exception(m_exception);
+	}
+}
+
+void CommandAwaiter::CommandSucceeded()
+{
+	Resume();
+}
+
+void CommandAwaiter::CommandAborted()
+{
+	m_exception = std::make_exception_ptr(CommandAbortedException());
+	Resume();
+}
+
+void CommandAwaiter::CommandFailed(const std::exception&, std::exception_ptr excPtr)
+{
+	m_exception = excPtr;
+	Resume();
+}
+
+void CommandAwaiter::Resume()
+{
+	// Never resume inline. The awaited command has not yet signaled its done event, so the coroutine could not execute
+	// it again, and the command's own thread would be tied up running the rest of the coroutine.
+	std::coroutine_handle<> awaiting = m_awaiting;
+	m_command->GetExecutor()->Execute([awaiting]() { awaiting.resume(); });
+}
+
+CommandAwaiter CommandLib::operator co_await(Command::Ptr command)
+{
+	return CommandAwaiter(command);
+}
+
+CoroutineCommand::Task CoroutineCommand::Task::promise_type::get_return_object()
+{
+	return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+std::suspend_always CoroutineCommand::Task::promise_type::initial_suspend() const noexcept
+{
+	return std::suspend_always();
+}
+
+void CoroutineCommand::Task::promise_type::return_void() const noexcept
+{
+}
+
+void CoroutineCommand::Task::promise_type::unhandled_exception() noexcept
+{
+	m_exception = std::current_exception();
+}
+
+void CoroutineCommand::Task::promise_type::OnFinished(std::coroutine_handle<promise_type> finished) noexcept
+{
+	// The command reference keeps the command alive until its listener has been informed
+	Command::Ptr command = std::move(finished.promise().m_command);
+	std::exception_ptr exc = finished.promise().m_exception;
+	finished.destroy();
+	static_cast<CoroutineCommand*>(command.get())->OnCoroutineFinished(exc);
+}
+
+CoroutineCommand::Task::Task(std::coroutine_handle<promise_type> handle) : m_handle(handle)
+{
+}
+
+CoroutineCommand::Task::Task(Task&& other) noexcept : m_handle(other.m_handle)
+{
+	other.m_handle = nullptr;
+}
+
+CoroutineCommand::Task::~Task()
+{
+	if (m_handle)
+	{
+		m_handle.destroy();
+	}
+}
+
+void CoroutineCommand::AsyncExecuteImpl(CommandListener* listener)
+{
+	m_listener = listener;
+	Task task = ExecuteCoroutine();
+	std::coroutine_handle<Task::promise_type> handle = task.m_handle;
+	task.m_handle = nullptr;
+	handle.promise().m_command = shared_from_this();
+
+	// The body must not start here. It could finish right away, and listeners may not be informed from within AsyncExecute().
+	GetExecutor()->Execute([handle]() { handle.resume(); });
+}
+
+void CoroutineCommand::OnCoroutineFinished(std::exception_ptr exc)
+{
+	CommandListener* listener = m_listener;
+	m_listener = nullptr;
+	InformListener(listener, exc);
+}
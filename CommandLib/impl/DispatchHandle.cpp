@@ -0,0 +1,104 @@
+#include "DispatchHandle.h"
+#include "CommandAbortedException.h"
+#include <stdexcept>
+
+using namespace CommandLib;
+
+DispatchHandle::DispatchHandle()
+{
+}
+
+DispatchHandle::DispatchHandle(std::shared_ptr<State> state) : m_state(state)
+{
+}
+
+bool DispatchHandle::IsValid() const
+{
+	return m_state != nullptr;
+}
+
+DispatchHandle::Outcome DispatchHandle::GetOutcome() const
+{
+	if (!m_state)
+	{
+		throw std::logic_error("This handle refers to no dispatch");
+	}
+
+	return m_state->outcome;
+}
+
+Waitable::Ptr DispatchHandle::DoneEvent() const
+{
+	if (!m_state)
+	{
+		throw std::logic_error("This handle refers to no dispatch");
+	}
+
+	// Shares ownership of the state, so that the event lives as long as anybody waits upon it
+	return Waitable::Ptr(m_state, &m_state->doneEvent);
+}
+
+void DispatchHandle::Wait() const
+{
+	DoneEvent()->Wait();
+}
+
+bool DispatchHandle::Wait(long long milliseconds) const
+{
+	return DoneEvent()->Wait(milliseconds);
+}
+
+void DispatchHandle::Get() const
+{
+	Wait();
+
+	if (m_state->error)
+	{
+		std::rethrow_exception(m_state->error);
+	}
+}
+
+std::exception_ptr DispatchHandle::Error() const
+{
+	if (!m_state)
+	{
+		throw std::logic_error("This handle refers to no dispatch");
+	}
+
+	// The error is written before the outcome, and never changes afterwards
+	return m_state->outcome == Outcome::Pending ? nullptr : m_state->error;
+}
+
+void DispatchHandle::Cancel()
+{
+	if (!m_state)
+	{
+		throw std::logic_error("This handle refers to no dispatch");
+	}
+
+	m_state->cancelled = true;
+	Command::Ptr command = m_state->command.lock();
+
+	// If the command has not started yet, the dispatcher will see the flag. If it is starting right now, the dispatcher
+	// checks the flag again once it has started.
+	if (command && m_state->outcome == Outcome::Pending)
+	{
+		command->Abort();
+	}
+}
+
+void DispatchHandle::State::Complete(const std::exception* exc, std::exception_ptr excPtr)
+{
+	// The error is written before the outcome, so that whoever sees the outcome sees the error too
+	if (exc == nullptr)
+	{
+		outcome = Outcome::Succeeded;
+	}
+	else
+	{
+		error = excPtr;
+		outcome = dynamic_cast<const CommandAbortedException*>(exc) != nullptr ? Outcome::Aborted : Outcome::Failed;
+	}
+
+	doneEvent.Set();
+}
@@ -1,63 +1,168 @@
 ﻿#include "Event.h"
+#include <thread>
+
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using namespace CommandLib;
 
-Event::Event() : m_signaled(false)
+#ifdef __linux__
+namespace
+{
+	uint32_t* FutexWord(std::atomic<uint32_t>& state)
+	{
+		static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "The state word must be usable as a futex");
+		return reinterpret_cast<uint32_t*>(&state);
+	}
+}
+#endif
+
+Event::Event() : m_state(0), m_notifying(0)
 {
 }
 
-Event::Event(bool initiallySignaled) : m_signaled(initiallySignaled)
+Event::Event(bool initiallySignaled) : m_state(initiallySignaled ? Signaled : 0), m_notifying(0)
 {
 }
 
 Event::~Event()
 {
+	// A thread that has been released by Set() may destroy this object while Set() is still informing listeners. The
+	// window is short, so simply yield until it closes.
+	while (m_notifying.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
 }
 
 void Event::Set()
 {
+	m_notifying.fetch_add(1, std::memory_order_relaxed);
+
+	// The exchange clears the waiters flag. Each woken thread sets it again if it has to go back to sleep.
+	if ((m_state.exchange(Signaled, std::memory_order_acq_rel) & HasWaiters) != 0)
 	{
-		std::unique_lock<std::recursive_mutex> lock(m_mutex);
-		m_signaled = true;
-		m_condition.notify_all();
+		WakeWaiters();
 	}
 
 	NotifyListeners();
+	m_notifying.fetch_sub(1, std::memory_order_release);
 }
 
 void Event::Reset()
 {
-	std::unique_lock<std::recursive_mutex> lock(m_mutex);
-	m_signaled = false;
+	m_state.fetch_and(~Signaled, std::memory_order_acq_rel);
 }
 
 bool Event::IsSignaled() const
 {
-	std::unique_lock<std::recursive_mutex> lock(m_mutex);
-	return m_signaled;
+	return (m_state.load(std::memory_order_acquire) & Signaled) != 0;
 }
 
 void Event::Wait() const
 {
-	std::unique_lock<std::recursive_mutex> lock(m_mutex);
-	
-	while (!m_signaled)
+	WaitUntil(nullptr);
+}
+
+bool Event::Wait(long long ms) const
+{
+	if (IsSignaled())
+	{
+		return true;
+	}
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if (ms >= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now).count())
 	{
-		m_condition.wait(lock);
+		WaitUntil(nullptr);
+		return true;
 	}
+
+	const std::chrono::steady_clock::time_point deadline = now + std::chrono::milliseconds(ms);
+	return WaitUntil(&deadline);
 }
 
-bool Event::Wait(long long ms) const
+#ifdef __linux__
+bool Event::WaitUntil(const std::chrono::steady_clock::time_point* deadline) const
 {
-	std::unique_lock<std::recursive_mutex> lock(m_mutex);
+	uint32_t state = m_state.load(std::memory_order_acquire);
 
-	while (!m_signaled)
+	while ((state & Signaled) == 0)
 	{
-		if (m_condition.wait_for(lock, std::chrono::milliseconds(ms)) == std::cv_status::timeout)
+		if ((state & HasWaiters) == 0)
 		{
-			return false;
+			if (!m_state.compare_exchange_weak(state, state | HasWaiters, std::memory_order_acquire))
+			{
+				continue;
+			}
+
+			state |= HasWaiters;
 		}
+
+		timespec remaining;
+		timespec* timeout = nullptr;
+
+		if (deadline != nullptr)
+		{
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+			if (now >= *deadline)
+			{
+				return false;
+			}
+
+			const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - now).count();
+			remaining.tv_sec = static_cast<time_t>(ns / 1000000000);
+			remaining.tv_nsec = static_cast<long>(ns % 1000000000);
+			timeout = &remaining;
+		}
+
+		// The relative timeout is measured against CLOCK_MONOTONIC, as is steady_clock. The call returns right away if
+		// the state has changed since it was loaded, so a Set() in between is never missed.
+		syscall(SYS_futex, FutexWord(m_state), FUTEX_WAIT_PRIVATE, state, timeout, nullptr, 0);
+		state = m_state.load(std::memory_order_acquire);
 	}
 
 	return true;
 }
+
+void Event::WakeWaiters()
+{
+	syscall(SYS_futex, FutexWord(m_state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+bool Event::WaitUntil(const std::chrono::steady_clock::time_point* deadline) const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// The waiters flag is set while holding the mutex, so WakeWaiters() cannot slip in between the check and the wait
+	while ((m_state.fetch_or(HasWaiters, std::memory_order_acq_rel) & Signaled) == 0)
+	{
+		if (deadline == nullptr)
+		{
+			m_condition.wait(lock);
+		}
+		else if (m_condition.wait_until(lock, *deadline) == std::cv_status::timeout)
+		{
+			return IsSignaled();
+		}
+	}
+
+	return true;
+}
+
+void Event::WakeWaiters()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+	}
+
+	m_condition.notify_all();
+}
+#endif
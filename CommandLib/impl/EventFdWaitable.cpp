@@ -0,0 +1,65 @@
+#include "EventFdWaitable.h"
+#ifdef __linux__
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace CommandLib;
+
+EventFdWaitable::Ptr EventFdWaitable::Create()
+{
+	return Create(false);
+}
+
+EventFdWaitable::Ptr EventFdWaitable::Create(bool initiallySignaled)
+{
+	Ptr result(new EventFdWaitable(initiallySignaled));
+	StartWatching(result);
+	return result;
+}
+
+EventFdWaitable::EventFdWaitable(bool initiallySignaled) : FdWaitable(CreateEventFd(initiallySignaled), Condition::Readable)
+{
+}
+
+int EventFdWaitable::CreateEventFd(bool initiallySignaled)
+{
+	const int fd = eventfd(initiallySignaled ? 1 : 0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if (fd == -1)
+	{
+		throw std::system_error(errno, std::generic_category(), "eventfd");
+	}
+
+	return fd;
+}
+
+void EventFdWaitable::Set()
+{
+	// Each write wakes the reactor, even if the counter was already non-zero, so listeners are informed of every Set()
+	const uint64_t one = 1;
+
+	if (write(m_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+	{
+		throw std::system_error(errno, std::generic_category(), "write(eventfd)");
+	}
+}
+
+void EventFdWaitable::Reset()
+{
+	// Reading returns the counter and sets it to zero. EAGAIN means it was already zero.
+	uint64_t counter;
+
+	if (read(m_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN)
+	{
+		throw std::system_error(errno, std::generic_category(), "read(eventfd)");
+	}
+}
+
+int EventFdWaitable::Fd() const
+{
+	return m_fd;
+}
+#endif
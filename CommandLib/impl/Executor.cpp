@@ -0,0 +1,12 @@
+#include "Executor.h"
+
+using namespace CommandLib;
+
+Executor::~Executor()
+{
+}
+
+bool Executor::IsWorkerThread() const
+{
+	return false;
+}
@@ -0,0 +1,109 @@
+#include "FdWaitable.h"
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <system_error>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using namespace CommandLib;
+
+FdWaitable::Ptr FdWaitable::Create(int fd, Condition condition)
+{
+	const int ownedFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+	if (ownedFd == -1)
+	{
+		throw std::system_error(errno, std::generic_category(), "fcntl(F_DUPFD_CLOEXEC)");
+	}
+
+	Ptr result(new FdWaitable(ownedFd, condition));
+	StartWatching(result);
+	return result;
+}
+
+FdWaitable::FdWaitable(int ownedFd, Condition condition) : m_fd(ownedFd), m_condition(condition), m_watchId(0)
+{
+}
+
+FdWaitable::~FdWaitable()
+{
+	if (m_watchId != 0)
+	{
+		Reactor::Default()->Unwatch(m_watchId);
+	}
+
+	close(m_fd);
+}
+
+void FdWaitable::StartWatching(const Ptr& waitable)
+{
+	// The reactor holds only a weak reference, so that a watch never keeps this object alive
+	std::weak_ptr<FdWaitable> weak = waitable;
+	const unsigned int events = waitable->m_condition == Condition::Readable ? EPOLLIN : EPOLLOUT;
+
+	waitable->m_watchId = Reactor::Default()->Watch(waitable->m_fd, events, [weak]()
+	{
+		if (Ptr strong = weak.lock())
+		{
+			strong->NotifyListeners();
+		}
+	});
+}
+
+FdWaitable::Condition FdWaitable::GetCondition() const
+{
+	return m_condition;
+}
+
+bool FdWaitable::IsSignaled() const
+{
+	return Poll(0);
+}
+
+void FdWaitable::Wait() const
+{
+	while (!Poll(-1))
+	{
+	}
+}
+
+bool FdWaitable::Wait(long long ms) const
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		const long long remaining = ms - std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		if (Poll(remaining <= 0 ? 0 : static_cast<int>(std::min<long long>(remaining, INT_MAX))))
+		{
+			return true;
+		}
+
+		if (remaining <= 0)
+		{
+			return false;
+		}
+	}
+}
+
+bool FdWaitable::Poll(int timeoutMS) const
+{
+	pollfd fds = {};
+	fds.fd = m_fd;
+	fds.events = m_condition == Condition::Readable ? POLLIN : POLLOUT;
+	const int result = poll(&fds, 1, timeoutMS);
+
+	if (result == -1 && errno != EINTR)
+	{
+		throw std::system_error(errno, std::generic_category(), "poll");
+	}
+
+	return result > 0;
+}
+#endif
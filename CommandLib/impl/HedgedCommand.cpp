@@ -0,0 +1,344 @@
+#include "HedgedCommand.h"
+#include "CommandAbortedException.h"
+#include <stdexcept>
+
+using namespace CommandLib;
+
+namespace
+{
+	// Until this many latencies have been observed, the initial delay is used
+	const uint64_t sm_minSamples = 20;
+
+	// Latencies are halved in weight after this many more have been observed, so that the delay follows changes in behavior
+	const uint64_t sm_decayInterval = 1000;
+}
+
+std::string HedgedCommand::ClassName() const
+{
+	return "HedgedCommand";
+}
+
+HedgedCommand::Ptr HedgedCommand::Create(const CommandFactory& factory, long long initialDelayMS)
+{
+	return Create(factory, 2, initialDelayMS, 95);
+}
+
+HedgedCommand::Ptr HedgedCommand::Create(const CommandFactory& factory, size_t maxAttempts, long long initialDelayMS, double percentile)
+{
+	if (maxAttempts == 0)
+	{
+		throw std::invalid_argument("maxAttempts must be greater than 0");
+	}
+
+	if (initialDelayMS < 0)
+	{
+		throw std::invalid_argument("initialDelayMS must not be negative");
+	}
+
+	if (!(percentile > 0 && percentile <= 100))
+	{
+		throw std::invalid_argument("percentile must be greater than 0 and no greater than 100");
+	}
+
+	// Every attempt is created before any is owned, so that a bad one leaves none of them attached to a half-built object
+	std::vector<Command::Ptr> attempts;
+
+	for (size_t i = 0; i < maxAttempts; ++i)
+	{
+		attempts.push_back(factory());
+
+		if (!attempts.back())
+		{
+			throw std::invalid_argument("The command factory returned null");
+		}
+	}
+
+	return Ptr(new HedgedCommand(attempts, initialDelayMS, percentile));
+}
+
+HedgedCommand::HedgedCommand(const std::vector<Command::Ptr>& attempts, long long initialDelayMS, double percentile)
+	: m_attempts(attempts), m_initialDelayMS(initialDelayMS), m_percentile(percentile),
+	m_latencies(sm_decayInterval)
+{
+	for (size_t i = 0; i < m_attempts.size(); ++i)
+	{
+		TakeOwnership(m_attempts[i]);
+		m_attemptListeners.emplace_back(new Listener(this, i));
+	}
+}
+
+long long HedgedCommand::HedgeDelayMS() const
+{
+	if (m_latencies.Count() < sm_minSamples)
+	{
+		return m_initialDelayMS;
+	}
+
+	// Round up, and never hedge immediately, which would double the load for no benefit
+	const long long delayMS = (m_latencies.Percentile(m_percentile) + 999) / 1000;
+	return delayMS < 1 ? 1 : delayMS;
+}
+
+std::string HedgedCommand::ExtendedDescription() const
+{
+	return "Attempts: " + std::to_string(m_attempts.size()) + "; Hedge delay MS: " + std::to_string(HedgeDelayMS());
+}
+
+void HedgedCommand::AsyncExecuteImpl(CommandListener* listener)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+		m_launched = 1;
+		m_running = 1;
+		m_won = false;
+		m_error = nullptr;
+		m_startTime = std::chrono::steady_clock::now();
+		++m_generation;
+
+		// Scheduled before the first attempt is launched, because once it is, it may finish (and this object with it) at any moment
+		ScheduleHedge();
+	}
+
+	try
+	{
+		m_attempts[0]->AsyncExecute(m_attemptListeners[0].get());
+	}
+	catch (...)
+	{
+		TimerService::TimerId timerId;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			++m_generation;
+			timerId = m_timerId;
+			m_timerId = 0;
+		}
+
+		TimerService::Default()->Cancel(timerId);
+		throw;
+	}
+}
+
+void HedgedCommand::AbortImpl()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_timerId != 0)
+	{
+		// The running attempts are aborted along with this object. There's no point in starting any more of them.
+		TimerService::Default()->Cancel(m_timerId);
+		m_timerId = 0;
+	}
+}
+
+void HedgedCommand::ScheduleHedge()
+{
+	// The caller holds m_mutex
+	if (m_launched == m_attempts.size())
+	{
+		return;
+	}
+
+	const unsigned long long generation = m_generation;
+	Command::Ptr thisCommand = shared_from_this();
+	m_timerId = TimerService::Default()->Schedule(HedgeDelayMS(), [this, thisCommand, generation]() { OnTimer(generation); });
+}
+
+void HedgedCommand::OnTimer(unsigned long long generation)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (generation != m_generation || m_timerId == 0)
+		{
+			return; // cancelled
+		}
+
+		m_timerId = 0;
+	}
+
+	// The backup is launched upon the executor rather than the timer thread
+	Command::Ptr thisCommand = shared_from_this();
+	GetExecutor()->Execute([this, thisCommand, generation]() { Hedge(generation); });
+}
+
+void HedgedCommand::Hedge(unsigned long long generation)
+{
+	size_t index;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (generation != m_generation || m_won || m_launched == m_attempts.size() || AbortEvent()->IsSignaled())
+		{
+			return;
+		}
+
+		index = m_launched++;
+		++m_running;
+		ScheduleHedge();
+	}
+
+	Launch(index);
+}
+
+void HedgedCommand::Launch(size_t index)
+{
+	try
+	{
+		m_attempts[index]->AsyncExecute(m_attemptListeners[index].get());
+	}
+	catch (std::exception&)
+	{
+		OnAttemptFinished(index, Outcome::Failed, std::current_exception());
+	}
+}
+
+void HedgedCommand::OnAttemptFinished(size_t index, Outcome outcome, std::exception_ptr excPtr)
+{
+	bool won = false;
+	bool finished = false;
+	size_t next = m_attempts.size();
+	size_t launched;
+	TimerService::TimerId timerId = 0;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (outcome == Outcome::Succeeded && !m_won)
+		{
+			m_won = true;
+			won = true;
+			// The whole execution is timed, not just the winning attempt, so that a slow first attempt counts as slow even when a
+			// backup wins. Otherwise the delay would settle below the requested percentile, and hedge ever more often.
+			m_latencies.Record(std::chrono::steady_clock::now() - m_startTime);
+			timerId = m_timerId;
+			m_timerId = 0;
+		}
+		else if (outcome == Outcome::Failed)
+		{
+			if (!m_error)
+			{
+				m_error = excPtr;
+			}
+
+			// A failed attempt is no result at all, so start the next one without waiting. It takes this one's place as running.
+			if (!m_won && m_launched < m_attempts.size() && !AbortEvent()->IsSignaled())
+			{
+				next = m_launched++;
+
+				if (m_timerId != 0)
+				{
+					// The next backup waits the delay after this one starts
+					timerId = m_timerId;
+					++m_generation;
+					ScheduleHedge();
+				}
+			}
+		}
+
+		// The winner stays counted as running until it has aborted the others, so that this object cannot finish (and perhaps be
+		// executed again) in between
+		if (next == m_attempts.size() && !won)
+		{
+			finished = --m_running == 0;
+		}
+
+		launched = m_launched;
+	}
+
+	if (timerId != 0)
+	{
+		TimerService::Default()->Cancel(timerId);
+	}
+
+	if (won)
+	{
+		for (size_t i = 0; i < launched; ++i)
+		{
+			if (i != index)
+			{
+				AbortChildCommand(m_attempts[i]);
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		finished = --m_running == 0;
+	}
+
+	if (next != m_attempts.size())
+	{
+		Launch(next);
+	}
+	else if (finished)
+	{
+		Finish();
+	}
+}
+
+void HedgedCommand::Finish()
+{
+	CommandListener* listener;
+	bool won;
+	std::exception_ptr error;
+	TimerService::TimerId timerId;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+		won = m_won;
+		error = m_error;
+		m_error = nullptr;
+
+		// The attempts may all have ended without this object being aborted (for example, if they aborted themselves), in which
+		// case a pending hedge must not launch another once the listener has been informed
+		++m_generation;
+		timerId = m_timerId;
+		m_timerId = 0;
+	}
+
+	if (timerId != 0)
+	{
+		TimerService::Default()->Cancel(timerId);
+	}
+
+	if (won)
+	{
+		// The losers were aborted by this object rather than by its owner, so they must not stay aborted should the owner
+		// execute this object again
+		if (!AbortEvent()->IsSignaled())
+		{
+			for (Command::Ptr attempt : m_attempts)
+			{
+				ResetChildAbortEvent(attempt);
+			}
+		}
+
+		listener->CommandSucceeded();
+	}
+	else
+	{
+		InformListener(listener, error ? error : std::make_exception_ptr(CommandAbortedException()));
+	}
+}
+
+HedgedCommand::Listener::Listener(HedgedCommand* command, size_t index) : m_command(command), m_index(index)
+{
+}
+
+void HedgedCommand::Listener::CommandSucceeded()
+{
+	m_command->OnAttemptFinished(m_index, Outcome::Succeeded, nullptr);
+}
+
+void HedgedCommand::Listener::CommandAborted()
+{
+	m_command->OnAttemptFinished(m_index, Outcome::Aborted, nullptr);
+}
+
+void HedgedCommand::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
+{
+	m_command->OnAttemptFinished(m_index, Outcome::Failed, excPtr);
+}
@@ -0,0 +1,109 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+
+using namespace CommandLib;
+
+LatencyHistogram::LatencyHistogram(uint64_t decayInterval) : m_decayInterval(decayInterval), m_sinceDecay(0)
+{
+	if (decayInterval == 0)
+	{
+		throw std::invalid_argument("decayInterval must be greater than 0");
+	}
+
+	m_counts.fill(0);
+}
+
+void LatencyHistogram::Record(long long microseconds)
+{
+	const size_t index = BucketIndex(microseconds < 0 ? 0 : static_cast<uint64_t>(microseconds));
+	std::unique_lock<std::mutex> lock(m_mutex);
+	++m_counts[index];
+
+	if (++m_sinceDecay == m_decayInterval)
+	{
+		m_sinceDecay = 0;
+
+		for (uint64_t& count : m_counts)
+		{
+			count /= 2;
+		}
+	}
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	uint64_t total = 0;
+
+	for (uint64_t count : m_counts)
+	{
+		total += count;
+	}
+
+	return total;
+}
+
+long long LatencyHistogram::Percentile(double percentile) const
+{
+	if (!(percentile > 0 && percentile <= 100))
+	{
+		throw std::invalid_argument("percentile must be greater than 0 and no greater than 100");
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	uint64_t total = 0;
+
+	for (uint64_t count : m_counts)
+	{
+		total += count;
+	}
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(total * percentile / 100)));
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < BucketCount; ++i)
+	{
+		seen += m_counts[i];
+
+		if (seen >= target)
+		{
+			return static_cast<long long>(std::min<uint64_t>(BucketUpperBound(i), LLONG_MAX));
+		}
+	}
+
+	return LLONG_MAX; // not reached
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t microseconds)
+{
+	// The first few values get a bucket each. After that, each power of two is split into SubBucketCount equal buckets,
+	// chosen by the bits just below the highest set bit.
+	if (microseconds < SubBucketCount)
+	{
+		return static_cast<size_t>(microseconds);
+	}
+
+	const size_t exponent = std::bit_width(microseconds) - 1;
+	return (exponent - 1) * SubBucketCount + static_cast<size_t>((microseconds >> (exponent - 2)) & (SubBucketCount - 1));
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index)
+{
+	if (index < SubBucketCount)
+	{
+		return index;
+	}
+
+	const size_t exponent = index / SubBucketCount + 1;
+	const uint64_t width = uint64_t(1) << (exponent - 2);
+	return (SubBucketCount + index % SubBucketCount) * width + (width - 1);
+}
@@ -1,7 +1,6 @@
 ﻿#include "ParallelCommands.h"
 #include "CommandAbortedException.h"
-#include <thread>
-#include <future>
+#include <stdexcept>
 
 using namespace CommandLib;
 
@@ -12,19 +11,36 @@ std::string ParallelCommands::ClassName() const
 
 ParallelCommands::Ptr ParallelCommands::Create(bool abortUponFailure)
 {
-	return Ptr(new ParallelCommands(abortUponFailure));
+	return Ptr(new ParallelCommands(abortUponFailure, 0, 0));
 }
 
-ParallelCommands::ParallelCommands(bool abortUponFailure) : m_abortUponFailure(abortUponFailure)
+ParallelCommands::Ptr ParallelCommands::Create(bool abortUponFailure, size_t maxConcurrency)
+{
+	return Ptr(new ParallelCommands(abortUponFailure, maxConcurrency, 0));
+}
+
+ParallelCommands::Ptr ParallelCommands::CreateRace(size_t requiredSuccesses)
+{
+	return CreateRace(requiredSuccesses, 0);
+}
+
+ParallelCommands::Ptr ParallelCommands::CreateRace(size_t requiredSuccesses, size_t maxConcurrency)
+{
+	if (requiredSuccesses == 0)
+	{
+		throw std::invalid_argument("requiredSuccesses must be greater than 0");
+	}
+
+	return Ptr(new ParallelCommands(false, maxConcurrency, requiredSuccesses));
+}
+
+ParallelCommands::ParallelCommands(bool abortUponFailure, size_t maxConcurrency, size_t requiredSuccesses) :
+	m_abortUponFailure(abortUponFailure), m_maxConcurrency(maxConcurrency), m_requiredSuccesses(requiredSuccesses)
 {
 }
 
 ParallelCommands::~ParallelCommands()
 {
-    if (m_thread)
-    {
-        m_thread->join();
-    }
 }
 
 void ParallelCommands::Add(Command::Ptr command)
@@ -48,42 +64,101 @@ void ParallelCommands::Clear()
 
 std::string ParallelCommands::ExtendedDescription() const
 {
-	return "Number of commands: " + std::to_string(m_commands.size()) + "; Abort upon failure ? " + std::to_string(m_abortUponFailure);
+	return "Number of commands: " + std::to_string(m_commands.size()) + "; Abort upon failure ? " + std::to_string(m_abortUponFailure) +
+		"; Max concurrency: " + std::to_string(m_maxConcurrency) + "; Required successes: " + std::to_string(m_requiredSuccesses);
 }
 
 void ParallelCommands::AsyncExecuteImpl(CommandListener* listener)
 {
-	if (m_commands.empty())
+	if (m_requiredSuccesses > m_commands.size())
 	{
-        if (m_thread)
-        {
-            m_thread->join();
-        }
+		throw std::logic_error("A race requires " + std::to_string(m_requiredSuccesses) + " successes, but there are only " +
+			std::to_string(m_commands.size()) + " commands");
+	}
 
-        m_thread.reset(new std::thread([listener]() { listener->CommandSucceeded(); }));
+	if (m_commands.empty())
+	{
+		// We must still notify the caller on a separate thread.
+		Command::Ptr thisCommand = shared_from_this();
+		GetExecutor()->Execute([thisCommand, listener]() { listener->CommandSucceeded(); });
     }
 	else
 	{
-		std::unique_ptr<Listener> eventHandler(new Listener(this, listener));
+		// The rest are launched one at a time by the listener, as the first ones finish
+		LaunchRange(new Listener(this, listener), 0, InitialLaunchCount(), false);
+	}
+}
+
+size_t ParallelCommands::InitialLaunchCount() const
+{
+	return (m_maxConcurrency == 0 || m_maxConcurrency > m_commands.size()) ? m_commands.size() : m_maxConcurrency;
+}
+
+void ParallelCommands::LaunchRange(Listener* eventHandler, size_t begin, size_t end, bool handedOff)
+{
+	// Once the last command is launched, they may all finish and this object be destroyed before this method returns
+	Command::Ptr thisCommand = shared_from_this();
+
+	// Split off the upper half of the range until what is left is small. With a work-stealing pool, idle workers steal the
+	// larger, older ranges and launch them in parallel, so a wide fan-out does not launch serially upon one thread.
+	size_t bounds[sizeof(size_t) * 8 + 1];
+	size_t boundCount = 0;
+	bounds[boundCount++] = end;
+
+	while (end - begin > LaunchGrain)
+	{
+		end = begin + (end - begin) / 2;
+		bounds[boundCount++] = end;
+	}
 
-		for (size_t i = 0; i < m_commands.size(); ++i)
+	// What is left is launched before anything is handed off, so that a launch that throws to the caller leaves no handed-off
+	// commands running against a listener that will never hear the last of them
+	for (size_t i = begin; i < end; ++i)
+	{
+		if (!handedOff)
 		{
-			m_commands[i]->AsyncExecute(eventHandler.get());
+			m_commands[i]->AsyncExecute(eventHandler);
+			continue;
 		}
 
-		eventHandler.release();
+		try
+		{
+			m_commands[i]->AsyncExecute(eventHandler);
+		}
+		catch (std::exception& exc)
+		{
+			// There is no caller to throw to, so report the command as failed on its behalf
+			eventHandler->CommandFailed(exc, std::current_exception());
+		}
+	}
+
+	// Largest first
+	for (size_t i = 1; i < boundCount; ++i)
+	{
+		const size_t rangeBegin = bounds[i];
+		const size_t rangeEnd = bounds[i - 1];
+		GetExecutor()->Execute([this, thisCommand, eventHandler, rangeBegin, rangeEnd]() { LaunchRange(eventHandler, rangeBegin, rangeEnd, true); });
 	}
 }
 
 ParallelCommands::Listener::Listener(ParallelCommands* command, CommandListener* listener) : m_command(command), m_listener(listener)
 {
+	m_successCount = 0;
 	m_failCount = 0;
 	m_abortCount = 0;
+	m_abortedChildren = false;
     m_remaining = m_command->m_commands.size();
+	m_nextLaunch = m_command->InitialLaunchCount();
 }
 
 void ParallelCommands::Listener::CommandSucceeded()
 {
+	if (++m_successCount == m_command->m_requiredSuccesses)
+	{
+		// The race is won. Nothing the others do from here on can change the outcome.
+		AbortAll();
+	}
+
     OnCommandFinished();
 }
 
@@ -95,27 +170,99 @@ void ParallelCommands::Listener::CommandAborted()
 
 void ParallelCommands::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
 {
-    if (++m_failCount == 1)
+	RecordFailure(excPtr);
+    OnCommandFinished();
+}
+
+void ParallelCommands::Listener::RecordFailure(std::exception_ptr excPtr)
+{
+	const size_t failCount = ++m_failCount;
+
+    if (failCount == 1)
     {
 		m_error = excPtr;
 
         if (m_command->m_abortUponFailure)
         {
-			for (Command::Ptr cmd : m_command->m_commands)
-            {
-                m_command->AbortChildCommand(cmd);
-            }
+			AbortAll();
         }
     }
 
-    OnCommandFinished();
+	// A race is lost once so many have failed that the required number of successes can no longer be reached
+	const size_t requiredSuccesses = m_command->m_requiredSuccesses;
+
+	if (requiredSuccesses != 0 && failCount == m_command->m_commands.size() - requiredSuccesses + 1)
+	{
+		AbortAll();
+	}
+}
+
+void ParallelCommands::Listener::AbortAll()
+{
+	m_abortedChildren = true;
+
+	for (Command::Ptr cmd : m_command->m_commands)
+	{
+		m_command->AbortChildCommand(cmd);
+	}
+}
+
+void ParallelCommands::Listener::LaunchNext()
+{
+	const std::vector<Command::Ptr>& commands = m_command->m_commands;
+
+	for (size_t index = m_nextLaunch++; index < commands.size(); index = m_nextLaunch++)
+	{
+		// The command that just finished is still counted as remaining, so none of the decrements below can be the last one
+		if (commands[index]->AbortEvent()->IsSignaled())
+		{
+			// Either this collection was aborted, or a failure aborted the rest of it. There's no point in starting this one.
+			++m_abortCount;
+			--m_remaining;
+			continue;
+		}
+
+		try
+		{
+			commands[index]->AsyncExecute(this);
+			return;
+		}
+		catch (std::exception&)
+		{
+			RecordFailure(std::current_exception());
+			--m_remaining;
+		}
+	}
 }
 
 void ParallelCommands::Listener::OnCommandFinished()
 {
+	// Each command that finishes makes room for another to start, if any are waiting
+	if (m_nextLaunch < m_command->m_commands.size())
+	{
+		LaunchNext();
+	}
+
     if (--m_remaining == 0)
     {
-        if (m_error)
+		// Commands aborted by this object (because a race was won or lost, or because one failed) rather than by its owner must
+		// not stay aborted should the owner execute this object again
+		if (m_abortedChildren && !m_command->AbortEvent()->IsSignaled())
+		{
+			for (Command::Ptr cmd : m_command->m_commands)
+			{
+				m_command->ResetChildAbortEvent(cmd);
+			}
+		}
+
+		const size_t requiredSuccesses = m_command->m_requiredSuccesses;
+
+		if (requiredSuccesses != 0 && m_successCount >= requiredSuccesses)
+		{
+			// The race was won, so the failures and aborts of the losers don't matter
+			m_listener->CommandSucceeded();
+		}
+        else if (m_error)
         {
 			try
 			{
@@ -134,5 +281,7 @@ void ParallelCommands::Listener::OnCommandFinished()
         {
             m_listener->CommandSucceeded();
         }
+
+		delete this;
     }
 }
@@ -1,7 +1,6 @@
 ﻿#include "PauseCommand.h"
 #include "CommandAbortedException.h"
 #include <functional>
-#include "WaitGroup.h"
 
 using namespace CommandLib;
 
@@ -24,6 +23,15 @@ PauseCommand::PauseCommand(long long ms, Waitable::Ptr stopEvent)
 	: m_externalCutShortEvent(stopEvent),
 	m_milliseconds(ms)
 {
+	// Built once, so that each wait does no setup of its own
+	m_waitGroup.AddWaitable(AbortEvent());
+	m_waitGroup.AddWaitable(m_resetEvent);
+	m_waitGroup.AddWaitable(m_cutShortEvent);
+
+	if (m_externalCutShortEvent.get() != nullptr)
+	{
+		m_waitGroup.AddWaitable(m_externalCutShortEvent);
+	}
 }
 
 void PauseCommand::CutShort()
@@ -77,16 +85,5 @@ void PauseCommand::SyncExeImpl()
 
 int PauseCommand::WaitForDuration() const
 {
-	WaitGroup eventGroup;
-	eventGroup.AddWaitable(AbortEvent());
-	eventGroup.AddWaitable(m_resetEvent);
-	eventGroup.AddWaitable(m_cutShortEvent);
-
-	if (m_externalCutShortEvent.get() != nullptr)
-	{
-		eventGroup.AddWaitable(m_externalCutShortEvent);
-	}
-
-	// TODO: deal with overflow?
-	return eventGroup.WaitForAny(m_milliseconds);
-}
\ No newline at end of file
+	return m_waitGroup.WaitForAny(m_milliseconds);
+}
@@ -1,6 +1,7 @@
 ﻿#include "PeriodicCommand.h"
 #include "ParallelCommands.h"
 #include "SequentialCommands.h"
+#include "CommandAbortedException.h"
 
 using namespace CommandLib;
 
@@ -38,8 +39,10 @@ PeriodicCommand::PeriodicCommand(
     bool intervalIsInclusive,
 	Waitable::Ptr stopEvent)
 	: m_stopEvent(stopEvent),
-	  m_initialPause(PauseCommand::Create(intervalMS, stopEvent)),
-	  m_pause(PauseCommand::Create(intervalMS, stopEvent))
+	  m_initialPause(AsyncPauseCommand::Create(intervalMS, stopEvent)),
+	  m_pause(AsyncPauseCommand::Create(intervalMS, stopEvent)),
+	  m_initialPauseListener(this, true),
+	  m_repetitionListener(this, false)
 {
 	TakeOwnership(m_initialPause);
 
@@ -120,43 +123,157 @@ std::string PeriodicCommand::ExtendedDescription() const
 	return "Repetitions: " + std::to_string(m_repeatCount) + "; Interval: " + std::to_string(GetIntervalMS()) + "ms";
 }
 
-void PeriodicCommand::SyncExeImpl()
+void PeriodicCommand::AsyncExecuteImpl(CommandListener* listener)
 {
-    if (m_startWithPause && m_repeatCount > 0)
-    {
-        m_initialPause->SyncExecute();
-    }
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+		m_repetition = 0;
+	}
+
+	if (m_startWithPause && m_repeatCount > 0)
+	{
+		m_initialPause->AsyncExecute(&m_initialPauseListener);
+		return;
+	}
 
-    for (size_t i = 0; i < m_repeatCount; ++i)
-    {
-		if (m_stopEvent.get() != nullptr && m_stopEvent->IsSignaled())
+	bool aborted;
+
+	if (!LaunchNextRepetition(&aborted))
+	{
+		// Nothing to run. The listener must not be informed from within this call.
+		Command::Ptr thisCommand = shared_from_this();
+
+		GetExecutor()->Execute([this, thisCommand, aborted]()
 		{
-			break;
-		}
+			Finish(aborted ? std::make_exception_ptr(CommandAbortedException()) : nullptr);
+		});
+	}
+}
+
+bool PeriodicCommand::LaunchNextRepetition(bool* aborted)
+{
+	size_t repetition;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		repetition = m_repetition++;
+	}
+
+	*aborted = false;
+
+	if (repetition >= m_repeatCount || (m_stopEvent.get() != nullptr && m_stopEvent->IsSignaled()))
+	{
+		return false;
+	}
+
+	if (AbortEvent()->IsSignaled())
+	{
+		*aborted = true;
+		return false;
+	}
+
+	if (repetition == m_repeatCount - 1)
+	{
+		// Don't pause for the last execution
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_overriddenInterval = m_pause->GetDurationMS();
+		m_intervalOverridden = true;
+		m_pause->SetDurationMS(0);
+	}
+
+	try
+	{
+		m_collectionCmd->AsyncExecute(&m_repetitionListener);
+	}
+	catch (...)
+	{
+		RestoreInterval();
+		throw;
+	}
+
+	return true;
+}
+
+void PeriodicCommand::RestoreInterval()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_intervalOverridden)
+	{
+		m_pause->SetDurationMS(m_overriddenInterval);
+		m_intervalOverridden = false;
+	}
+}
+
+void PeriodicCommand::Continue()
+{
+	bool aborted;
 
-        CheckAbortFlag();
-
-        if (i == m_repeatCount - 1)
-        {
-            // Don't pause for the last execution
-            long long prevInterval = m_pause->GetDurationMS();
-            m_pause->SetDurationMS(0);
-
-            try
-            {
-                m_collectionCmd->SyncExecute();
-            }
-			catch (...)
-            {
-                m_pause->SetDurationMS(prevInterval);
-				throw;
-            }
-		
-			m_pause->SetDurationMS(prevInterval);
+	try
+	{
+		if (LaunchNextRepetition(&aborted))
+		{
+			return;
 		}
-        else
-        {
-            m_collectionCmd->SyncExecute();
-        }
-    }
+	}
+	catch (...)
+	{
+		Finish(std::current_exception());
+		return;
+	}
+
+	Finish(aborted ? std::make_exception_ptr(CommandAbortedException()) : nullptr);
+}
+
+void PeriodicCommand::OnRepetitionFinished(bool isInitialPause, std::exception_ptr exc)
+{
+	RestoreInterval();
+
+	if (exc)
+	{
+		Finish(exc);
+	}
+	else if (isInitialPause)
+	{
+		Continue();
+	}
+	else
+	{
+		// A command may not be relaunched from within its own completion callback, so the next repetition is handed off
+		Command::Ptr thisCommand = shared_from_this();
+		GetExecutor()->Execute([this, thisCommand]() { Continue(); });
+	}
+}
+
+void PeriodicCommand::Finish(std::exception_ptr exc)
+{
+	CommandListener* listener;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+	}
+
+	InformListener(listener, exc);
+}
+
+PeriodicCommand::Listener::Listener(PeriodicCommand* command, bool isInitialPause) : m_command(command), m_isInitialPause(isInitialPause)
+{
+}
+
+void PeriodicCommand::Listener::CommandSucceeded()
+{
+	m_command->OnRepetitionFinished(m_isInitialPause, nullptr);
+}
+
+void PeriodicCommand::Listener::CommandAborted()
+{
+	m_command->OnRepetitionFinished(m_isInitialPause, std::make_exception_ptr(CommandAbortedException()));
+}
+
+void PeriodicCommand::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
+{
+	m_command->OnRepetitionFinished(m_isInitialPause, excPtr);
 }
@@ -0,0 +1,173 @@
+#include "Reactor.h"
+#ifdef __linux__
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace CommandLib;
+
+namespace
+{
+	std::mutex sm_defaultMutex;
+
+	// Intentionally never deleted, so that static destruction does not race with waitables still in use at process exit.
+	Reactor::Ptr* sm_default = nullptr;
+
+	// The wake descriptor is registered under this id, which is never handed out by Watch()
+	const Reactor::WatchId WakeId = 0;
+}
+
+Reactor::Ptr Reactor::Create()
+{
+	return Ptr(new Reactor());
+}
+
+Reactor::Ptr Reactor::Default()
+{
+	std::unique_lock<std::mutex> lock(sm_defaultMutex);
+
+	if (sm_default == nullptr)
+	{
+		sm_default = new Ptr(Create());
+	}
+
+	return *sm_default;
+}
+
+Reactor::Reactor() : m_lastId(0), m_stopping(false), m_epollFd(epoll_create1(EPOLL_CLOEXEC)), m_wakeFd(-1)
+{
+	if (m_epollFd == -1)
+	{
+		throw std::system_error(errno, std::generic_category(), "epoll_create1");
+	}
+
+	m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if (m_wakeFd == -1)
+	{
+		const int error = errno;
+		close(m_epollFd);
+		throw std::system_error(error, std::generic_category(), "eventfd");
+	}
+
+	epoll_event wake = {};
+	wake.events = EPOLLIN;
+	wake.data.u64 = WakeId;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &wake);
+
+	m_thread = std::thread(&Reactor::ReactorRoutine, this);
+}
+
+Reactor::~Reactor()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+
+	const uint64_t one = 1;
+	ssize_t written = write(m_wakeFd, &one, sizeof(one));
+	(void)written;
+	m_thread.join();
+	close(m_wakeFd);
+	close(m_epollFd);
+}
+
+Reactor::WatchId Reactor::Watch(int fd, unsigned int events, std::function<void()> callback)
+{
+	WatchId id;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		id = ++m_lastId;
+		m_watches[id] = Watched{ fd, std::make_shared<const std::function<void()>>(std::move(callback)) };
+	}
+
+	epoll_event watched = {};
+	watched.events = events | EPOLLET;
+	watched.data.u64 = id;
+
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &watched) == -1)
+	{
+		const int error = errno;
+		Unwatch(id);
+		throw std::system_error(error, std::generic_category(), "epoll_ctl");
+	}
+
+	return id;
+}
+
+bool Reactor::Unwatch(WatchId id)
+{
+	int fd;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto it = m_watches.find(id);
+
+		if (it == m_watches.end())
+		{
+			return false;
+		}
+
+		fd = it->second.fd;
+		m_watches.erase(it);
+	}
+
+	// Events for this id that are already queued are ignored by the reactor thread, since the id is no longer found
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	return true;
+}
+
+void Reactor::ReactorRoutine()
+{
+	epoll_event events[64];
+
+	while (true)
+	{
+		const int count = epoll_wait(m_epollFd, events, sizeof(events) / sizeof(events[0]), -1);
+
+		if (count == -1)
+		{
+			continue; // EINTR
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			const WatchId id = events[i].data.u64;
+
+			if (id == WakeId)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				if (m_stopping)
+				{
+					return;
+				}
+
+				continue;
+			}
+
+			std::shared_ptr<const std::function<void()>> callback;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				auto it = m_watches.find(id);
+
+				if (it != m_watches.end())
+				{
+					callback = it->second.callback;
+				}
+			}
+
+			if (callback)
+			{
+				(*callback)();
+			}
+		}
+	}
+}
+#endif
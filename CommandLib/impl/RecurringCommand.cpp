@@ -1,4 +1,5 @@
 ﻿#include "RecurringCommand.h"
+#include "CommandAbortedException.h"
 
 using namespace CommandLib;
 
@@ -13,7 +14,7 @@ std::string RecurringCommand::ClassName() const
 }
 
 RecurringCommand::RecurringCommand(Command::Ptr command, ExecutionTimeCallback* callback)
-	: m_callback(callback), m_scheduledCmd(ScheduledCommand::Create(command, std::chrono::system_clock::now(), true))
+	: m_callback(callback), m_scheduledCmd(ScheduledCommand::Create(command, std::chrono::system_clock::now(), true)), m_scheduledListener(this)
 {
 	TakeOwnership(m_scheduledCmd);
 }
@@ -28,17 +29,111 @@ void RecurringCommand::SetNextExecutionTime(const std::chrono::time_point<std::c
     m_scheduledCmd->SetTimeOfExecution(time);
 }
 
-void RecurringCommand::SyncExeImpl()
+void RecurringCommand::AsyncExecuteImpl(CommandListener* listener)
 {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+	}
+
     std::chrono::time_point<std::chrono::system_clock> executionTime;
-    bool keepGoing = m_callback->GetFirstExecutionTime(&executionTime);
-
-    while (keepGoing)
-    {
-        m_scheduledCmd->SetTimeOfExecution(executionTime);
-        CheckAbortFlag();
-        m_scheduledCmd->SyncExecute();
-        executionTime = m_scheduledCmd->GetTimeOfExecution(); // in case it was changed
-        keepGoing = m_callback->GetNextExecutionTime(&executionTime);
-    }
+	std::exception_ptr exc;
+
+	try
+	{
+		if (m_callback->GetFirstExecutionTime(&executionTime))
+		{
+			m_scheduledCmd->SetTimeOfExecution(executionTime);
+			m_scheduledCmd->AsyncExecute(&m_scheduledListener);
+			return;
+		}
+	}
+	catch (...)
+	{
+		exc = std::current_exception();
+	}
+
+	// Finished before starting. The listener must not be informed from within this call.
+	Command::Ptr thisCommand = shared_from_this();
+	GetExecutor()->Execute([this, thisCommand, exc]() { Finish(exc); });
+}
+
+void RecurringCommand::OnExecutionFinished(std::exception_ptr exc)
+{
+	if (exc)
+	{
+		Finish(exc);
+		return;
+	}
+
+	std::chrono::time_point<std::chrono::system_clock> executionTime = m_scheduledCmd->GetTimeOfExecution(); // in case it was changed
+
+	try
+	{
+		if (!m_callback->GetNextExecutionTime(&executionTime))
+		{
+			Finish(nullptr);
+			return;
+		}
+	}
+	catch (...)
+	{
+		Finish(std::current_exception());
+		return;
+	}
+
+	// A command may not be relaunched from within its own completion callback, so the next execution is handed off
+	Command::Ptr thisCommand = shared_from_this();
+	GetExecutor()->Execute([this, thisCommand, executionTime]() { Launch(executionTime); });
+}
+
+void RecurringCommand::Launch(const std::chrono::time_point<std::chrono::system_clock>& executionTime)
+{
+	if (AbortEvent()->IsSignaled())
+	{
+		Finish(std::make_exception_ptr(CommandAbortedException()));
+		return;
+	}
+
+	try
+	{
+		m_scheduledCmd->SetTimeOfExecution(executionTime);
+		m_scheduledCmd->AsyncExecute(&m_scheduledListener);
+	}
+	catch (...)
+	{
+		Finish(std::current_exception());
+	}
+}
+
+void RecurringCommand::Finish(std::exception_ptr exc)
+{
+	CommandListener* listener;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+	}
+
+	InformListener(listener, exc);
+}
+
+RecurringCommand::Listener::Listener(RecurringCommand* command) : m_command(command)
+{
+}
+
+void RecurringCommand::Listener::CommandSucceeded()
+{
+	m_command->OnExecutionFinished(nullptr);
+}
+
+void RecurringCommand::Listener::CommandAborted()
+{
+	m_command->OnExecutionFinished(std::make_exception_ptr(CommandAbortedException()));
+}
+
+void RecurringCommand::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
+{
+	m_command->OnExecutionFinished(excPtr);
 }
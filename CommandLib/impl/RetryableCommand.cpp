@@ -1,5 +1,7 @@
 ﻿#include "RetryableCommand.h"
 #include "CommandAbortedException.h"
+#include <algorithm>
+#include <stdexcept>
 
 using namespace CommandLib;
 
@@ -12,45 +14,193 @@ RetryableCommand::RetryCallback::~RetryCallback()
 {
 }
 
+RetryableCommand::ExponentialBackoff::ExponentialBackoff(size_t maxRetries, long long baseMS, long long capMS)
+	: m_maxRetries(maxRetries), m_baseMS(baseMS), m_capMS(capMS), m_lastWaitMS(baseMS), m_random(std::random_device()())
+{
+	if (baseMS < 0)
+	{
+		throw std::invalid_argument("baseMS must not be negative");
+	}
+
+	if (capMS < baseMS)
+	{
+		throw std::invalid_argument("capMS must not be less than baseMS");
+	}
+}
+
+bool RetryableCommand::ExponentialBackoff::OnCommandFailed(size_t failNumber, const std::exception&, long long* waitMS)
+{
+	if (failNumber > m_maxRetries)
+	{
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (failNumber == 1)
+	{
+		m_lastWaitMS = m_baseMS;
+	}
+
+	// Guard against overflow when tripling
+	const long long upper = m_lastWaitMS > m_capMS / 3 ? m_capMS : std::max(m_baseMS, m_lastWaitMS * 3);
+	m_lastWaitMS = std::min(m_capMS, std::uniform_int_distribution<long long>(m_baseMS, upper)(m_random));
+	*waitMS = m_lastWaitMS;
+	return true;
+}
+
 RetryableCommand::Ptr RetryableCommand::Create(Command::Ptr command, RetryCallback* callback)
 {
 	return Ptr (new RetryableCommand(command, callback));
 }
 
+RetryableCommand::Ptr RetryableCommand::Create(Command::Ptr command, size_t maxRetries, long long baseMS, long long capMS)
+{
+	std::unique_ptr<RetryCallback> callback(new ExponentialBackoff(maxRetries, baseMS, capMS));
+	Ptr result(new RetryableCommand(command, callback.get()));
+	result->m_ownedCallback = std::move(callback);
+	return result;
+}
+
 RetryableCommand::RetryableCommand(Command::Ptr command, RetryCallback* callback)
-	: m_command(command), m_callback(callback), m_pauseCmd(PauseCommand::Create(0))
+	: m_command(command), m_callback(callback), m_childListener(this)
 {
-	TakeOwnership(m_pauseCmd);
     TakeOwnership(m_command);
 }
 
-void RetryableCommand::SyncExeImpl()
+void RetryableCommand::AsyncExecuteImpl(CommandListener* listener)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+		m_failCount = 0;
+	}
+
+	// A pending abort is handled by the wrapped command itself, which is never allowed to report back from within this call
+	m_command->AsyncExecute(&m_childListener);
+}
+
+void RetryableCommand::AbortImpl()
+{
+	bool cancelled = false;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (m_timerId != 0 && TimerService::Default()->Cancel(m_timerId))
+		{
+			m_timerId = 0;
+			cancelled = true;
+		}
+	}
+
+	if (cancelled)
+	{
+		// Aborted while waiting to retry. Don't inform the listener upon the aborting thread.
+		Command::Ptr thisCommand = shared_from_this();
+		GetExecutor()->Execute([this, thisCommand]() { Finish(std::make_exception_ptr(CommandAbortedException())); });
+	}
+}
+
+void RetryableCommand::Launch()
 {
-    size_t i = 0;
+	if (AbortEvent()->IsSignaled())
+	{
+		Finish(std::make_exception_ptr(CommandAbortedException()));
+		return;
+	}
+
+	try
+	{
+		m_command->AsyncExecute(&m_childListener);
+	}
+	catch (...)
+	{
+		Finish(std::current_exception());
+	}
+}
+
+void RetryableCommand::OnTimer(unsigned long long generation)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (generation != m_generation || m_timerId == 0)
+		{
+			return; // cancelled by an abort
+		}
 
-	for (;;)
-    {
-        try
-        {
-            CheckAbortFlag();
-            m_command->SyncExecute();
+		m_timerId = 0;
+	}
+
+	// The retry is launched upon the executor rather than the timer thread. This also guarantees that the wrapped command is
+	// not relaunched from within its own completion callback.
+	Command::Ptr thisCommand = shared_from_this();
+	GetExecutor()->Execute([this, thisCommand]() { Launch(); });
+}
+
+void RetryableCommand::OnCommandFailed(const std::exception& exc, std::exception_ptr excPtr)
+{
+	size_t failNumber;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		failNumber = ++m_failCount;
+	}
+
+	long long waitTime = 0;
+
+	if (!m_callback->OnCommandFailed(failNumber, exc, &waitTime))
+	{
+		Finish(excPtr);
+		return;
+	}
+
+	{
+		// Checking the abort flag and scheduling the retry are done atomically with respect to AbortImpl, so that an abort
+		// can never be missed while waiting.
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (!AbortEvent()->IsSignaled())
+		{
+			const unsigned long long generation = ++m_generation;
+			Command::Ptr thisCommand = shared_from_this();
+			m_timerId = TimerService::Default()->Schedule(waitTime, [this, thisCommand, generation]() { OnTimer(generation); });
 			return;
-        }
-        catch(CommandAbortedException&)
-        {
-            throw;
-        }
-        catch(std::exception& exc)
-        {
-            long long waitTime;
-
-            if (!m_callback->OnCommandFailed(++i, exc, &waitTime))
-            {
-                throw;
-            }
-
-            m_pauseCmd->SetDurationMS(waitTime);
-            m_pauseCmd->SyncExecute();
-        }
-    }
+		}
+	}
+
+	Finish(std::make_exception_ptr(CommandAbortedException()));
+}
+
+void RetryableCommand::Finish(std::exception_ptr exc)
+{
+	CommandListener* listener;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+	}
+
+	InformListener(listener, exc);
+}
+
+RetryableCommand::Listener::Listener(RetryableCommand* command) : m_command(command)
+{
+}
+
+void RetryableCommand::Listener::CommandSucceeded()
+{
+	m_command->Finish(nullptr);
+}
+
+void RetryableCommand::Listener::CommandAborted()
+{
+	m_command->Finish(std::make_exception_ptr(CommandAbortedException()));
+}
+
+void RetryableCommand::Listener::CommandFailed(const std::exception& exc, std::exception_ptr excPtr)
+{
+	m_command->OnCommandFailed(exc, excPtr);
 }
@@ -1,4 +1,5 @@
 ﻿#include "ScheduledCommand.h"
+#include "CommandAbortedException.h"
 using namespace CommandLib;
 
 namespace
@@ -32,7 +33,9 @@ ScheduledCommand::ScheduledCommand(
 	: m_command(command),
 	  m_runImmediatelyIfTimeIsPast(runImmediatelyIfTimeIsPast),
 	  m_timeOfExecution(timeOfExecution),
-	  m_pauseCmd(PauseCommand::Create(0))
+	  m_pauseCmd(AsyncPauseCommand::Create(0)),
+	  m_pauseListener(this, true),
+	  m_commandListener(this, false)
 {
     TakeOwnership(m_command);
 	TakeOwnership(m_pauseCmd);
@@ -84,19 +87,82 @@ std::string ScheduledCommand::ExtendedDescription() const
     return "Time to execute: " + TimeAsText(GetTimeOfExecution()) + "; Run immediately if time is in the past? " + (m_runImmediatelyIfTimeIsPast ? "yes" : "no");
 }
 
-void ScheduledCommand::SyncExeImpl()
+void ScheduledCommand::AsyncExecuteImpl(CommandListener* listener)
 {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+	}
+
 	const auto waitTime = GetTimeOfExecution() - std::chrono::system_clock::now();
 
     if (waitTime.count() >= 0)
     {
 		m_pauseCmd->SetDuration(waitTime);
-        m_pauseCmd->SyncExecute();
+        m_pauseCmd->AsyncExecute(&m_pauseListener);
     }
-    else if (!m_runImmediatelyIfTimeIsPast)
+    else if (m_runImmediatelyIfTimeIsPast)
     {
-        throw std::invalid_argument("'" + Description() + "' was scheduled to run at " + TimeAsText(GetTimeOfExecution()) + ", which is in the past");
+		m_command->AsyncExecute(&m_commandListener);
     }
+	else
+	{
+		// The listener must not be informed from within this call
+		std::exception_ptr exc = std::make_exception_ptr(std::invalid_argument(
+			"'" + Description() + "' was scheduled to run at " + TimeAsText(GetTimeOfExecution()) + ", which is in the past"));
+
+		Command::Ptr thisCommand = shared_from_this();
+		GetExecutor()->Execute([this, thisCommand, exc]() { Finish(exc); });
+	}
+}
+
+void ScheduledCommand::OnPauseSucceeded()
+{
+	try
+	{
+		m_command->AsyncExecute(&m_commandListener);
+	}
+	catch (...)
+	{
+		Finish(std::current_exception());
+	}
+}
+
+void ScheduledCommand::Finish(std::exception_ptr exc)
+{
+	CommandListener* listener;
 
-    m_command->SyncExecute();
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+	}
+
+	InformListener(listener, exc);
+}
+
+ScheduledCommand::Listener::Listener(ScheduledCommand* command, bool isPause) : m_command(command), m_isPause(isPause)
+{
+}
+
+void ScheduledCommand::Listener::CommandSucceeded()
+{
+	if (m_isPause)
+	{
+		m_command->OnPauseSucceeded();
+	}
+	else
+	{
+		m_command->Finish(nullptr);
+	}
+}
+
+void ScheduledCommand::Listener::CommandAborted()
+{
+	m_command->Finish(std::make_exception_ptr(CommandAbortedException()));
+}
+
+void ScheduledCommand::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
+{
+	m_command->Finish(excPtr);
 }
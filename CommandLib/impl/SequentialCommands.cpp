@@ -1,8 +1,6 @@
 ﻿#include "SequentialCommands.h"
 #include "CommandAbortedException.h"
 #include <algorithm>
-#include <thread>
-#include <future>
 
 using namespace CommandLib;
 
@@ -16,16 +14,12 @@ SequentialCommands::Ptr SequentialCommands::Create()
 	return Ptr (new SequentialCommands());
 }
 
-SequentialCommands::SequentialCommands()
+SequentialCommands::SequentialCommands() : m_listener(this)
 {
 }
 
 SequentialCommands::~SequentialCommands()
 {
-	if (m_thread)
-	{
-		m_thread->join();
-	}
 }
 
 void SequentialCommands::Add(Command::Ptr command)
@@ -80,31 +74,42 @@ public:
 	virtual void CommandFailed(const std::exception&, std::exception_ptr excPtr)
 	{
 		m_error = excPtr;
-		m_finishedEvent;
+		m_finishedEvent->Set();
 	}
 private:
 	Event* const m_finishedEvent;
 	std::exception_ptr m_error;
 };
 
+void SequentialCommands::CacheTraits()
+{
+	m_synchronous.resize(m_commands.size());
+
+	for (size_t i = 0; i < m_commands.size(); ++i)
+	{
+		m_synchronous[i] = m_commands[i]->IsNaturallySynchronous();
+	}
+}
+
 void SequentialCommands::SyncExecuteImpl()
 {
-	std::list<Command::Ptr>::iterator it = m_commands.begin();
+	CacheTraits();
+	size_t i = 0;
 
-	while (it != m_commands.end() && (*it)->IsNaturallySynchronous())
+	while (i < m_commands.size() && m_synchronous[i])
 	{
 		CheckAbortFlag();
-		(*it)->SyncExecute();
-		++it;
+		m_commands[i]->SyncExecute();
+		++i;
 	}
 
-	if (it != m_commands.end())
+	if (i < m_commands.size())
 	{
 		// We encountered a command that is asynchronous in nature.
 		CheckAbortFlag();
 		Event finishedEvent(false);
 		DelegateListener delegateListener(&finishedEvent);
-		DoAsyncExecute(&delegateListener, it, m_commands.end());
+		m_listener.Start(&delegateListener, i);
 		finishedEvent.Wait();
 
 		if (delegateListener.GetError())
@@ -119,72 +124,91 @@ void SequentialCommands::AsyncExecuteImpl(CommandListener* listener)
 	if (m_commands.empty())
 	{
 		// No commands in the collection. We must still notify the caller on a separate thread.
-		if (m_thread)
-		{
-			m_thread->join();
-		}
-
-		m_thread.reset(new std::thread([listener]() {listener->CommandSucceeded(); }));
+		Command::Ptr thisCommand = shared_from_this();
+		GetExecutor()->Execute([thisCommand, listener]() { listener->CommandSucceeded(); });
 		return;
 	}
 
+	CacheTraits();
+
 	// We execute the first command asynchronously regardless of whether it is naturally asynchronous, because this call must not block.
-	DoAsyncExecute(listener, m_commands.begin(), m_commands.end());
+	m_listener.Start(listener, 0);
 }
 
-void SequentialCommands::DoAsyncExecute(
-	CommandListener* listener, std::list<Command::Ptr>::iterator iter, std::list<Command::Ptr>::iterator end)
+SequentialCommands::Listener::Listener(SequentialCommands* command) : m_command(command)
 {
-	m_listener.SetExternalListener(listener);
-	m_listener.SetCommands(iter, end);
-	(*iter)->AsyncExecute(&m_listener);
 }
 
-void SequentialCommands::Listener::SetExternalListener(CommandListener* listener)
+void SequentialCommands::Listener::Start(CommandListener* listener, size_t index)
 {
 	m_externalListener = listener;
+	m_index = index;
+	m_command->m_commands[index]->AsyncExecute(this);
 }
 
-void SequentialCommands::Listener::SetCommands(
-	std::list<Command::Ptr>::iterator iter, std::list<Command::Ptr>::iterator end)
+void SequentialCommands::Listener::CommandSucceeded()
 {
-	m_iter = iter;
-	m_end = end;
+	++m_index;
+	Run(false);
 }
 
-void SequentialCommands::Listener::CommandSucceeded()
+void SequentialCommands::Listener::Run(bool onExecutor)
 {
-	++m_iter;
+	// Runs naturally synchronous commands one after another upon this thread, at constant stack depth, until the sequence
+	// finishes or a command must be left to finish asynchronously. Nothing here may touch this object once the external listener
+	// has been informed, or once an asynchronous command has been launched (it may finish, and call back, at any moment).
+	// A call handed to the executor runs there by definition, even if the executor cannot tell its own threads apart.
+	const bool workerThread = onExecutor || m_command->GetExecutor()->IsWorkerThread();
 
-	if (m_iter == m_end)
+	for (;;)
 	{
-		m_externalListener->CommandSucceeded();
-	}
-	else if ((*m_iter)->AbortEvent()->IsSignaled())
-	{
-		m_externalListener->CommandAborted();
-	}
-	else if ((*m_iter)->IsNaturallySynchronous())
-	{
-		try
+		const std::vector<Command::Ptr>& commands = m_command->m_commands;
+
+		if (m_index == commands.size())
+		{
+			m_externalListener->CommandSucceeded();
+			return;
+		}
+
+		const Command::Ptr& command = commands[m_index];
+
+		if (command->AbortEvent()->IsSignaled())
 		{
-			(*m_iter)->SyncExecute();
+			m_externalListener->CommandAborted();
+			return;
+		}
 
-			// Recursive call
-			CommandSucceeded();
+		if (!m_command->m_synchronous[m_index])
+		{
+			command->AsyncExecute(this);
+			return;
+		}
+
+		if (!workerThread)
+		{
+			// Running the command here could block a thread the executor does not own (for example, when an asynchronous command
+			// finished upon a timer thread), so hand the rest of the sequence off
+			Command::Ptr thisCommand = m_command->shared_from_this();
+			m_command->GetExecutor()->Execute([thisCommand, this]() { Run(true); });
+			return;
+		}
+
+		try
+		{
+			command->SyncExecute();
 		}
 		catch (CommandAbortedException&)
 		{
 			m_externalListener->CommandAborted();
+			return;
 		}
 		catch (std::exception& exc)
 		{
 			m_externalListener->CommandFailed(exc, std::current_exception());
+			return;
 		}
-	}
-	else
-	{
-		(*m_iter)->AsyncExecute(this);
+
+		++m_index;
 	}
 }
 
@@ -196,4 +220,4 @@ void SequentialCommands::Listener::CommandAborted()
 void SequentialCommands::Listener::CommandFailed(const std::exception& exc, std::exception_ptr excPtr)
 {
 	m_externalListener->CommandFailed(exc, excPtr);
-}
+}
\ No newline at end of file
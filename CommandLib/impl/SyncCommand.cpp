@@ -6,10 +6,6 @@ using namespace CommandLib;
 
 SyncCommand::~SyncCommand()
 {
-	if (m_thread)
-	{
-		m_thread->join();
-	}
 }
 
 void SyncCommand::PrepareExecute()
@@ -25,12 +21,10 @@ void SyncCommand::AsyncExecuteImpl(CommandListener* listener)
 {
     PrepareExecute();
 
-	if (m_thread)
-	{
-		m_thread->join();
-	}
-
-	m_thread.reset(new std::thread(ExecuteRoutine, this, listener));
+	// The task holds a reference to this command so that it cannot be destroyed while the worker is still
+	// unwinding from the listener callback (which signals the done event).
+	Ptr thisCommand = shared_from_this();
+	GetExecutor()->Execute([thisCommand, this, listener]() { ExecuteRoutine(this, listener); });
 }
 
 void SyncCommand::SyncExecuteImpl()
@@ -0,0 +1,392 @@
+#include "ThreadPool.h"
+#include "TimerService.h"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+
+using namespace CommandLib;
+
+namespace
+{
+	// How long a worker started to relieve a fully busy pool lingers before exiting
+	const std::chrono::seconds sm_extraWorkerIdleTime(5);
+
+	// How long queued work may wait with no worker idle before extra workers are started
+	const std::chrono::milliseconds sm_starvationCheckDelay(1);
+
+	std::mutex sm_defaultMutex;
+	size_t sm_defaultThreadCount = 0;
+
+	// Intentionally never deleted, so that commands still running at process exit do not cause static destruction to block.
+	ThreadPool::Ptr* sm_default = nullptr;
+}
+
+ThreadPool::Ptr ThreadPool::Create(size_t threadCount)
+{
+	return Ptr(new ThreadPool(threadCount));
+}
+
+ThreadPool::Ptr ThreadPool::Default()
+{
+	std::unique_lock<std::mutex> lock(sm_defaultMutex);
+
+	if (sm_default == nullptr)
+	{
+		size_t threadCount = sm_defaultThreadCount;
+
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1U, std::thread::hardware_concurrency());
+		}
+
+		sm_default = new Ptr(Create(threadCount));
+	}
+
+	return *sm_default;
+}
+
+void ThreadPool::SetDefaultThreadCount(size_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		throw std::invalid_argument("threadCount must be greater than 0");
+	}
+
+	std::unique_lock<std::mutex> lock(sm_defaultMutex);
+
+	if (sm_default != nullptr)
+	{
+		throw std::logic_error("The default thread pool is already in use. Its thread count can no longer be changed.");
+	}
+
+	sm_defaultThreadCount = threadCount;
+}
+
+ThreadPool::ThreadPool(size_t threadCount) : m_threadCount(threadCount), m_state(new State(threadCount))
+{
+	if (m_threadCount == 0)
+	{
+		throw std::invalid_argument("threadCount must be greater than 0");
+	}
+
+	m_state->StartPermanentWorkers(m_state);
+}
+
+ThreadPool::~ThreadPool()
+{
+	m_state->Shutdown();
+}
+
+void ThreadPool::Execute(std::function<void()> task)
+{
+	m_state->Post(std::move(task), m_state);
+}
+
+bool ThreadPool::IsWorkerThread() const
+{
+	return m_state->IsWorkerThread();
+}
+
+size_t ThreadPool::ThreadCount() const
+{
+	return m_threadCount;
+}
+
+thread_local const ThreadPool::State* ThreadPool::State::tl_state = nullptr;
+thread_local ThreadPool::State::WorkQueue* ThreadPool::State::tl_queue = nullptr;
+thread_local size_t ThreadPool::State::tl_nextVictim = 0;
+
+ThreadPool::State::State(size_t threadCount) : m_queuedCount(0), m_idleCount(0), m_stopping(false), m_starvationCheckPending(false), m_starvationGrowth(1)
+{
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		m_queues.emplace_back(new WorkQueue());
+	}
+}
+
+void ThreadPool::State::StartPermanentWorkers(const std::shared_ptr<State>& state)
+{
+	for (const std::unique_ptr<WorkQueue>& queue : m_queues)
+	{
+		StartWorker(state, queue.get());
+	}
+}
+
+void ThreadPool::State::StartWorker(const std::shared_ptr<State>& state, WorkQueue* queue)
+{
+	// The new worker cannot touch the worker map until it acquires the mutex, so there is no race with the insertion below.
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_stopping)
+	{
+		return; // Shutdown() has already collected the workers it will wait for
+	}
+
+	std::thread worker(WorkerRoutine, state, queue);
+	m_workers.emplace(worker.get_id(), std::move(worker));
+}
+
+void ThreadPool::State::Post(std::function<void()> task, const std::shared_ptr<State>& state)
+{
+	++m_queuedCount;
+
+	if (m_stopping)
+	{
+		--m_queuedCount;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+		}
+
+		m_condition.notify_all(); // workers that saw the count may be waiting for this work
+		throw std::logic_error("Work was posted to a thread pool that is being destroyed");
+	}
+
+	// Work posted by one of this pool's own workers goes upon that worker's queue, where it will look first
+	WorkQueue& queue = (tl_state == this && tl_queue != nullptr) ? *tl_queue : m_injected;
+
+	{
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	const size_t idleCount = m_idleCount;
+
+	if (idleCount > 0)
+	{
+		// A worker that is about to wait holds the mutex while it looks for work, so this cannot slip in between
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+		}
+
+		m_condition.notify_one();
+	}
+
+	if (m_queuedCount > idleCount)
+	{
+		ScheduleStarvationCheck(state);
+	}
+}
+
+void ThreadPool::State::Shutdown()
+{
+	std::unordered_map<std::thread::id, std::thread> workers;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		workers.swap(m_workers);
+	}
+
+	m_condition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		if (worker.first == std::this_thread::get_id())
+		{
+			// The pool is being destroyed by one of its own workers. That worker holds a reference to this state,
+			// and will exit on its own once it returns to its loop.
+			worker.second.detach();
+		}
+		else
+		{
+			worker.second.join();
+		}
+	}
+}
+
+bool ThreadPool::State::IsWorkerThread() const
+{
+	return tl_state == this;
+}
+
+bool ThreadPool::State::TryTake(WorkQueue* own, std::function<void()>& task)
+{
+	if (m_queuedCount == 0)
+	{
+		return false;
+	}
+
+	if (own != nullptr && TakeNewest(*own, task))
+	{
+		return true;
+	}
+
+	if (TakeOldest(m_injected, task))
+	{
+		return true;
+	}
+
+	// Start with a different victim each time, so that thieves do not all pile onto the same queue
+	const size_t queueCount = m_queues.size();
+	const size_t first = tl_nextVictim++;
+
+	for (size_t i = 0; i < queueCount; ++i)
+	{
+		WorkQueue& victim = *m_queues[(first + i) % queueCount];
+
+		if (&victim != own && TakeOldest(victim, task))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ThreadPool::State::TakeNewest(WorkQueue& queue, std::function<void()>& task)
+{
+	std::unique_lock<std::mutex> lock(queue.mutex);
+
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	--m_queuedCount;
+	return true;
+}
+
+bool ThreadPool::State::TakeOldest(WorkQueue& queue, std::function<void()>& task)
+{
+	std::unique_lock<std::mutex> lock(queue.mutex);
+
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+
+	task = std::move(queue.tasks.front());
+	queue.tasks.pop_front();
+	--m_queuedCount;
+	return true;
+}
+
+void ThreadPool::State::ScheduleStarvationCheck(const std::shared_ptr<State>& state)
+{
+	if (m_starvationCheckPending.exchange(true))
+	{
+		return;
+	}
+
+	// Short work is usually picked up by a busy worker well before the check runs, and needs no extra thread
+	std::weak_ptr<State> weakState = state;
+
+	TimerService::Default()->Schedule(sm_starvationCheckDelay, [weakState]()
+	{
+		if (std::shared_ptr<State> state = weakState.lock())
+		{
+			state->CheckStarvation(state);
+		}
+	});
+}
+
+void ThreadPool::State::CheckStarvation(const std::shared_ptr<State>& state)
+{
+	size_t startCount = 0;
+	bool stillStarved = false;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_starvationCheckPending = false;
+
+		if (m_stopping)
+		{
+			return;
+		}
+
+		JoinRetiredWorkers();
+		const size_t queuedCount = m_queuedCount;
+		const size_t idleCount = m_idleCount;
+
+		if (queuedCount > idleCount)
+		{
+			// A backlog of short work drains with a few extra workers, while work blocked behind blocked workers keeps the
+			// backlog in place, so the number started doubles for as long as the backlog lasts
+			startCount = std::min(queuedCount - idleCount, m_starvationGrowth);
+			stillStarved = startCount < queuedCount - idleCount;
+		}
+
+		m_starvationGrowth = stillStarved ? m_starvationGrowth * 2 : 1;
+	}
+
+	for (size_t i = 0; i < startCount; ++i)
+	{
+		StartWorker(state, nullptr);
+	}
+
+	if (stillStarved)
+	{
+		ScheduleStarvationCheck(state);
+	}
+}
+
+void ThreadPool::State::JoinRetiredWorkers()
+{
+	// Retired workers have already released the mutex for the last time, so joining them here cannot deadlock.
+	for (std::thread::id id : m_retired)
+	{
+		auto it = m_workers.find(id);
+
+		if (it != m_workers.end())
+		{
+			it->second.join();
+			m_workers.erase(it);
+		}
+	}
+
+	m_retired.clear();
+}
+
+void ThreadPool::State::WorkerRoutine(std::shared_ptr<State> state, WorkQueue* queue)
+{
+	// Workers without a queue of their own were started to relieve a pool whose workers are all blocked
+	const bool temporary = queue == nullptr;
+	tl_state = state.get();
+	tl_queue = queue;
+	std::function<void()> task;
+
+	for (;;)
+	{
+		if (!state->TryTake(queue, task))
+		{
+			std::unique_lock<std::mutex> lock(state->m_mutex);
+			++state->m_idleCount;
+			bool timedOut = false;
+
+			while (!state->TryTake(queue, task))
+			{
+				if ((state->m_stopping && state->m_queuedCount == 0) || timedOut)
+				{
+					// Either the pool is shutting down, or this is an extra worker that has been idle long enough
+					--state->m_idleCount;
+
+					if (temporary && !state->m_stopping)
+					{
+						state->m_retired.push_back(std::this_thread::get_id());
+					}
+
+					tl_state = nullptr;
+					tl_queue = nullptr;
+					return;
+				}
+
+				if (temporary)
+				{
+					timedOut = state->m_condition.wait_for(lock, sm_extraWorkerIdleTime) == std::cv_status::timeout;
+				}
+				else
+				{
+					state->m_condition.wait(lock);
+				}
+			}
+
+			--state->m_idleCount;
+		}
+
+		task();
+		task = nullptr; // release anything the task captured before waiting for more work
+	}
+}
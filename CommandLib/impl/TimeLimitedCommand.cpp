@@ -14,7 +14,8 @@ TimeLimitedCommand::Ptr TimeLimitedCommand::Create(Command::Ptr commandToRun, lo
 	return Ptr(new TimeLimitedCommand(timeoutMS, commandToRun));
 }
 
-TimeLimitedCommand::TimeLimitedCommand(long long timeoutMS, Command::Ptr commandToRun) : m_timeoutMS(timeoutMS), m_commandToRun(commandToRun)
+TimeLimitedCommand::TimeLimitedCommand(long long timeoutMS, Command::Ptr commandToRun)
+	: m_commandToRun(commandToRun), m_timeoutMS(timeoutMS), m_childListener(this)
 {
 	TakeOwnership(m_commandToRun);
 }
@@ -24,25 +25,117 @@ std::string TimeLimitedCommand::ExtendedDescription() const
 	return "Timeout MS: " + std::to_string(m_timeoutMS);
 }
 
-void TimeLimitedCommand::SyncExeImpl()
+void TimeLimitedCommand::AsyncExecuteImpl(CommandListener* listener)
 {
-	std::unique_ptr<Listener> eventHandler(new Listener(this));
-	m_commandToRun->AsyncExecute(eventHandler.get());
-	eventHandler.release();
-	const bool finished = m_commandToRun->DoneEvent()->Wait(m_timeoutMS);
+	TimerService::TimerId timerId;
 
-    if (!finished)
-    {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_listener = listener;
+		m_timedOut = false;
+		m_abortInProgress = false;
+		m_childFinished = false;
+		m_lastException = nullptr;
+		const unsigned long long generation = ++m_generation;
+		Command::Ptr thisCommand = shared_from_this();
+		m_timerId = TimerService::Default()->Schedule(m_timeoutMS, [this, thisCommand, generation]() { OnTimeout(generation); });
+		timerId = m_timerId;
+	}
+
+	try
+	{
+		m_commandToRun->AsyncExecute(&m_childListener);
+	}
+	catch (...)
+	{
+		TimerService::Default()->Cancel(timerId);
+		throw;
+	}
+}
+
+void TimeLimitedCommand::OnTimeout(unsigned long long generation)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (generation != m_generation || m_childFinished)
+		{
+			return;
+		}
+
+		m_timedOut = true;
+		m_abortInProgress = true;
+	}
+
+	// This runs upon the timer thread, so the abort itself is handed off. Finishing is deferred until the abort has been
+	// issued, so that a new execution cannot start in between and be aborted by mistake.
+	Command::Ptr thisCommand = shared_from_this();
+
+	GetExecutor()->Execute([this, thisCommand]()
+	{
 		AbortChildCommand(m_commandToRun);
-		m_commandToRun->Wait();
-		ResetChildAbortEvent(m_commandToRun);
-		throw CommandTimeoutException("Timed out after waiting " + std::to_string(m_timeoutMS) + "ms for command '" + m_commandToRun->Description() + "' to finish");
-    }
+		bool childFinished;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_abortInProgress = false;
+			childFinished = m_childFinished;
+		}
+
+		if (childFinished)
+		{
+			Finish();
+		}
+	});
+}
+
+void TimeLimitedCommand::OnChildFinished(std::exception_ptr exc)
+{
+	bool abortInProgress;
+	TimerService::TimerId timerId;
 
-    if (m_lastException)
-    {
-		std::rethrow_exception(m_lastException);
-    }
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_childFinished = true;
+		m_lastException = exc;
+		abortInProgress = m_abortInProgress;
+		timerId = m_timerId;
+		m_timerId = 0;
+	}
+
+	TimerService::Default()->Cancel(timerId);
+
+	if (!abortInProgress)
+	{
+		Finish();
+	}
+}
+
+void TimeLimitedCommand::Finish()
+{
+	CommandListener* listener;
+	bool timedOut;
+	std::exception_ptr lastException;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		listener = m_listener;
+		m_listener = nullptr;
+		timedOut = m_timedOut;
+		lastException = m_lastException;
+		m_lastException = nullptr;
+	}
+
+	if (timedOut)
+	{
+		ResetChildAbortEvent(m_commandToRun);
+		CommandTimeoutException exc("Timed out after waiting " + std::to_string(m_timeoutMS) + "ms for command '" + m_commandToRun->Description() + "' to finish");
+		listener->CommandFailed(exc, std::make_exception_ptr(exc));
+	}
+	else
+	{
+		InformListener(listener, lastException);
+	}
 }
 
 TimeLimitedCommand::Listener::Listener(TimeLimitedCommand* command) : m_command(command)
@@ -51,18 +144,15 @@ TimeLimitedCommand::Listener::Listener(TimeLimitedCommand* command) : m_command(
 
 void TimeLimitedCommand::Listener::CommandSucceeded()
 {
-	m_command->m_lastException = nullptr;
-	delete this;
+	m_command->OnChildFinished(nullptr);
 }
 
 void TimeLimitedCommand::Listener::CommandAborted()
 {
-	m_command->m_lastException = std::make_exception_ptr(CommandAbortedException());
-	delete this;
+	m_command->OnChildFinished(std::make_exception_ptr(CommandAbortedException()));
 }
 
 void TimeLimitedCommand::Listener::CommandFailed(const std::exception&, std::exception_ptr excPtr)
 {
-	m_command->m_lastException = excPtr;
-	delete this;
+	m_command->OnChildFinished(excPtr);
 }
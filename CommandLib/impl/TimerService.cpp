@@ -0,0 +1,138 @@
+#include "TimerService.h"
+
+using namespace CommandLib;
+
+namespace
+{
+	std::mutex sm_defaultMutex;
+
+	// Intentionally never deleted, so that static destruction does not race with commands still running at process exit.
+	TimerService::Ptr* sm_default = nullptr;
+}
+
+TimerService::Ptr TimerService::Create()
+{
+	return Ptr(new TimerService());
+}
+
+TimerService::Ptr TimerService::Default()
+{
+	std::unique_lock<std::mutex> lock(sm_defaultMutex);
+
+	if (sm_default == nullptr)
+	{
+		sm_default = new Ptr(Create());
+	}
+
+	return *sm_default;
+}
+
+TimerService::TimerService() : m_lastId(0), m_stopping(false)
+{
+	m_thread = std::thread(&TimerService::TimerRoutine, this);
+}
+
+TimerService::~TimerService()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+
+	m_condition.notify_one();
+	m_thread.join();
+}
+
+TimerService::TimerId TimerService::Schedule(long long ms, std::function<void()> callback)
+{
+	const TimePoint now = std::chrono::steady_clock::now();
+	TimePoint deadline = TimePoint::max();
+
+	// Guard against overflow for very long durations
+	if (ms <= 0)
+	{
+		deadline = now;
+	}
+	else if (std::chrono::milliseconds(ms) < std::chrono::duration_cast<std::chrono::milliseconds>(TimePoint::max() - now))
+	{
+		deadline = now + std::chrono::milliseconds(ms);
+	}
+
+	bool earliest;
+	TimerId id;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		id = ++m_lastId;
+		auto inserted = m_timers.emplace(Key(deadline, id), std::move(callback)).first;
+		m_deadlines.emplace(id, deadline);
+		earliest = inserted == m_timers.begin();
+	}
+
+	if (earliest)
+	{
+		m_condition.notify_one();
+	}
+
+	return id;
+}
+
+bool TimerService::Cancel(TimerId id)
+{
+	std::function<void()> callback;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto it = m_deadlines.find(id);
+
+		if (it == m_deadlines.end())
+		{
+			return false;
+		}
+
+		auto timer = m_timers.find(Key(it->second, id));
+		callback = std::move(timer->second); // destroyed outside the lock, in case it owns something with a lengthy destructor
+		m_timers.erase(timer);
+		m_deadlines.erase(it);
+	}
+
+	return true;
+}
+
+void TimerService::TimerRoutine()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_stopping)
+	{
+		if (m_timers.empty())
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+
+		auto first = m_timers.begin();
+		const TimePoint deadline = first->first.first; // copied, since the timer may be cancelled while waiting
+
+		if (deadline == TimePoint::max())
+		{
+			// Effectively never fires. Waiting until the max time point is not reliable on all platforms.
+			m_condition.wait(lock);
+			continue;
+		}
+
+		if (deadline > std::chrono::steady_clock::now())
+		{
+			m_condition.wait_until(lock, deadline);
+			continue;
+		}
+
+		std::function<void()> callback = std::move(first->second);
+		m_deadlines.erase(first->first.second);
+		m_timers.erase(first);
+		lock.unlock();
+		callback();
+		callback = nullptr;
+		lock.lock();
+	}
+}
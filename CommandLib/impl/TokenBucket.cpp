@@ -0,0 +1,59 @@
+#include "TokenBucket.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace CommandLib;
+
+TokenBucket::TokenBucket(double ratePerSecond, double burst)
+	: m_ratePerSecond(ratePerSecond), m_burst(burst), m_tokens(burst), m_lastRefill(std::chrono::steady_clock::now())
+{
+	if (!(ratePerSecond > 0))
+	{
+		throw std::invalid_argument("ratePerSecond must be greater than 0");
+	}
+
+	if (!(burst >= 1))
+	{
+		throw std::invalid_argument("burst must be at least 1");
+	}
+}
+
+bool TokenBucket::IsAvailable(std::chrono::steady_clock::time_point now)
+{
+	Refill(now);
+	return m_tokens >= 1;
+}
+
+bool TokenBucket::TryTake(std::chrono::steady_clock::time_point now)
+{
+	if (!IsAvailable(now))
+	{
+		return false;
+	}
+
+	m_tokens -= 1;
+	return true;
+}
+
+long long TokenBucket::MillisecondsUntilAvailable(std::chrono::steady_clock::time_point now)
+{
+	if (IsAvailable(now))
+	{
+		return 0;
+	}
+
+	return (long long)std::ceil((1 - m_tokens) * 1000 / m_ratePerSecond);
+}
+
+void TokenBucket::Refill(std::chrono::steady_clock::time_point now)
+{
+	if (now <= m_lastRefill)
+	{
+		return;
+	}
+
+	const double elapsedSeconds = std::chrono::duration<double>(now - m_lastRefill).count();
+	m_tokens = std::min(m_burst, m_tokens + elapsedSeconds * m_ratePerSecond);
+	m_lastRefill = now;
+}
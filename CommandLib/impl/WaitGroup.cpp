@@ -8,6 +8,8 @@ WaitGroup::WaitGroup() : m_impl(WaitGroupImpl::Create())
 
 WaitGroup::~WaitGroup()
 {
+	// The waitables refer to the implementation through their listener sets, so it would otherwise live on with them
+	m_impl->RemoveAll();
 }
 
 void WaitGroup::AddWaitable(Waitable::Ptr item)
@@ -40,26 +42,47 @@ std::shared_ptr<WaitGroup::WaitGroupImpl> WaitGroup::WaitGroupImpl::Create()
 	return Ptr(new WaitGroupImpl());
 }
 
-WaitGroup::WaitGroupImpl::WaitGroupImpl() : m_firstSignaled(nullptr)
+WaitGroup::WaitGroupImpl::WaitGroupImpl() : m_count(0), m_wait(0), m_signaledCount(0), m_firstSignaled(-1)
 {
 }
 
 WaitGroup::WaitGroupImpl::~WaitGroupImpl()
 {
-	for (Waitable::Ptr item : m_list)
-	{
-		item->RemoveListener(shared_from_this());
-	}
 }
 
 void WaitGroup::WaitGroupImpl::AddWaitable(Waitable::Ptr item)
 {
+	Entry* entry;
+
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
-		m_list.push_back(item);
+
+		if (m_count < InlineCapacity)
+		{
+			entry = &m_inline[m_count];
+		}
+		else
+		{
+			m_overflow.emplace_back();
+			entry = &m_overflow.back();
+		}
+
+		entry->m_waitable = item;
+		entry->m_group = this;
+		entry->m_index = static_cast<int>(m_count);
+		++m_count;
 	}
 
-	item->AddListener(shared_from_this());
+	item->AddListener(Monitor(*entry));
+}
+
+void WaitGroup::WaitGroupImpl::RemoveAll()
+{
+	for (size_t i = 0; i < m_count; ++i)
+	{
+		Entry& entry = At(i);
+		entry.m_waitable->RemoveListener(Monitor(entry));
+	}
 }
 
 int WaitGroup::WaitGroupImpl::WaitForAny() const
@@ -86,15 +109,30 @@ void WaitGroup::WaitGroupImpl::WaitForAll() const
 	}
 }
 
-void WaitGroup::WaitGroupImpl::Signaled(const Waitable& waitable)
+WaitGroup::WaitGroupImpl::Entry& WaitGroup::WaitGroupImpl::At(size_t index) const
+{
+	return index < InlineCapacity ? m_inline[index] : m_overflow[index - InlineCapacity];
+}
+
+WaitMonitor::Ptr WaitGroup::WaitGroupImpl::Monitor(Entry& entry)
+{
+	// Shares ownership with this object rather than allocating a control block per entry
+	return WaitMonitor::Ptr(shared_from_this(), &entry);
+}
+
+void WaitGroup::WaitGroupImpl::Signaled(int index)
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
+	const Entry& entry = At(index);
 
-	if (m_signaled.insert(&waitable).second)
+	if (entry.m_signaledWait != m_wait)
 	{
-		if (m_firstSignaled == nullptr)
+		entry.m_signaledWait = m_wait;
+		++m_signaledCount;
+
+		if (m_firstSignaled == -1)
 		{
-			m_firstSignaled = &waitable;
+			m_firstSignaled = index;
 		}
 
 		m_waitSignaledEvent.Set();
@@ -105,48 +143,47 @@ int WaitGroup::WaitGroupImpl::AnySignaled() const
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
 	m_waitSignaledEvent.Reset();
-
-	if (m_firstSignaled != nullptr)
-	{
-		int result = 0;
-
-		for (Waitable::Ptr item : m_list)
-		{
-			if (item.get() == m_firstSignaled)
-			{
-				return result;
-			}
-
-			++result;
-		}
-	}
-
-	return -1;
+	return m_firstSignaled;
 }
 
 bool WaitGroup::WaitGroupImpl::AllSignaled() const
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
 	m_waitSignaledEvent.Reset();
-	return m_signaled.size() == m_list.size();
+	return m_signaledCount == m_count;
 }
 
 void WaitGroup::WaitGroupImpl::InitializeSignaled() const
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
-	m_firstSignaled = nullptr;
-	m_signaled.clear();
 
-	for (Waitable::Ptr item : m_list)
+	// Starting a new wait implicitly clears every entry's signaled mark
+	++m_wait;
+	m_signaledCount = 0;
+	m_firstSignaled = -1;
+
+	for (size_t i = 0; i < m_count; ++i)
 	{
-		if (item->IsSignaled())
+		const Entry& entry = At(i);
+
+		if (entry.m_waitable->IsSignaled())
 		{
-			if (m_firstSignaled == nullptr)
+			if (m_firstSignaled == -1)
 			{
-				m_firstSignaled = item.get();
+				m_firstSignaled = static_cast<int>(i);
 			}
 
-			m_signaled.insert(item.get());
+			entry.m_signaledWait = m_wait;
+			++m_signaledCount;
 		}
 	}
 }
+
+WaitGroup::WaitGroupImpl::Entry::Entry() : m_group(nullptr), m_index(0), m_signaledWait(0)
+{
+}
+
+void WaitGroup::WaitGroupImpl::Entry::Signaled(const Waitable&)
+{
+	m_group->Signaled(m_index);
+}
@@ -12,6 +12,16 @@ namespace CommandLib
 	public:
 		/// <inheritdoc/>
 		virtual bool IsNaturallySynchronous() const final;
+	protected:
+		/// <summary>
+		/// Informs a listener of the outcome of execution. Implementations that track the outcome as an exception may find this
+		/// useful.
+		/// </summary>
+		/// <param name="listener">The listener to inform</param>
+		/// <param name="exc">
+		/// Null upon success. A <see cref="CommandAbortedException"/> if aborted. Otherwise the reason for failure.
+		/// </param>
+		static void InformListener(CommandListener* listener, std::exception_ptr exc);
 	private:
 		virtual void SyncExecuteImpl() final;
 
@@ -0,0 +1,130 @@
+#pragma once
+#include "AsyncCommand.h"
+#include "TimerService.h"
+#include "WaitMonitor.h"
+#include <chrono>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// A <see cref="Command"/> that does nothing for a specified duration, without occupying a thread while it waits.
+	/// </summary>
+	/// <remarks>
+	/// This behaves like <see cref="PauseCommand"/>, but it is naturally asynchronous. The pause is tracked by
+	/// <see cref="TimerService::Default"/>, and the listener is informed upon the command's <see cref="Executor"/> when the
+	/// pause ends. Prefer this over <see cref="PauseCommand"/> when many pauses may be pending at once.
+	/// </remarks>
+	class AsyncPauseCommand : public AsyncCommand
+	{
+	public:
+		/// <summary>Shared pointer to a non-modifyable AsyncPauseCommand object</summary>
+		typedef std::shared_ptr<const AsyncPauseCommand> ConstPtr;
+
+		/// <summary>Shared pointer to an AsyncPauseCommand object</summary>
+		typedef std::shared_ptr<AsyncPauseCommand> Ptr;
+
+		/// <summary>Creates an AsyncPauseCommand object as a top-level <see cref="Command"/></summary>
+		/// <param name="dur">The amount of time to pause</param>
+		template<typename Rep, typename Period>
+		static Ptr Create(const std::chrono::duration<Rep, Period>& dur)
+		{
+			return Create(std::chrono::duration_cast<std::chrono::milliseconds>(dur).count());
+		}
+
+		/// <summary>Creates an AsyncPauseCommand object as a top-level <see cref="Command"/></summary>
+		/// <param name="ms">The number of milliseconds to pause.</param>
+		static Ptr Create(long long ms);
+
+		/// <summary>Creates an AsyncPauseCommand object as a top-level <see cref="Command"/></summary>
+		/// <param name="dur">The amount of time to pause</param>
+		/// <param name="stopEvent">
+		/// Optional event to indicate that the AsyncPauseCommand should stop. Raising this event is equivalent to calling <see cref="CutShort"/>
+		/// </param>
+		template<typename Rep, typename Period>
+		static Ptr Create(const std::chrono::duration<Rep, Period>& dur, Waitable::Ptr stopEvent)
+		{
+			return Create(std::chrono::duration_cast<std::chrono::milliseconds>(dur).count(), stopEvent);
+		}
+
+		/// <summary>Creates an AsyncPauseCommand object as a top-level <see cref="Command"/></summary>
+		/// <param name="ms">The number of milliseconds to pause</param>
+		/// <param name="stopEvent">
+		/// Optional event to indicate that the AsyncPauseCommand should stop. Raising this event is equivalent to calling <see cref="CutShort"/>
+		/// </param>
+		static Ptr Create(long long ms, Waitable::Ptr stopEvent);
+
+		virtual ~AsyncPauseCommand();
+
+		/// <summary>
+		/// If currently executing, finishes the pause now. Does *not* cause this command to be aborted.
+		/// </summary>
+		void CutShort();
+
+		/// <summary>
+		/// If currently executing, starts the pause all over again, with the currently set duration value
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		/// The amount of time to pause in milliseconds
+		/// </summary>
+		/// <returns>The amount of time to pause</returns>
+		long long GetDurationMS() const;
+
+		/// <summary>
+		/// Sets the amount of time to pause
+		/// </summary>
+		/// <param name="dur"/>The amount of time to pause</param>
+		/// <remarks>It is safe to change this while the command is executing, but doing so will have no effect until the next time it is executed (or <see cref="Reset"/> is called).</remarks>
+		template<typename Rep, typename Period>
+		void SetDuration(const std::chrono::duration<Rep, Period>& dur)
+		{
+			SetDurationMS(std::chrono::duration_cast<std::chrono::milliseconds>(dur).count());
+		}
+
+		/// <summary>
+		/// Sets the amount of time to pause in milliseconds
+		/// </summary>
+		/// <param name="ms"/>The amount of milliseconds to pause</param>
+		/// <remarks>It is safe to change this while the command is executing, but doing so will have no effect until the next time it is executed (or <see cref="Reset"/> is called).</remarks>
+		void SetDurationMS(long long ms);
+
+		/// <inheritdoc/>
+		virtual std::string ExtendedDescription() const override;
+
+		/// <inheritdoc/>
+		virtual std::string ClassName() const override;
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		AsyncPauseCommand(long long ms, Waitable::Ptr stopEvent);
+	private:
+		enum class Outcome { Succeeded, Aborted };
+
+		class StopMonitor : public WaitMonitor
+		{
+		public:
+			explicit StopMonitor(AsyncPauseCommand* command);
+			virtual void Signaled(const Waitable& waitable) override final;
+		private:
+			AsyncPauseCommand* const m_command;
+		};
+
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+		virtual void AbortImpl() override final;
+
+		void StartTimer();
+		void OnTimer(unsigned long long generation);
+		void Finish(Outcome outcome);
+
+		Waitable::Ptr m_externalCutShortEvent;
+		std::shared_ptr<StopMonitor> m_stopMonitor;
+		CommandListener* m_listener = nullptr;
+		TimerService::TimerId m_timerId = 0;
+		unsigned long long m_generation = 0;
+		bool m_active = false;
+		long long m_milliseconds;
+		mutable std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdexcept>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// The type of exception thrown by <see cref="CommandDispatcher::Dispatch"/> when a command is turned away because the backlog
+	/// is full
+	/// </summary>
+	class BacklogFullException : public std::runtime_error
+	{
+	public:
+		/// <summary>Constructor</summary>
+		BacklogFullException();
+
+		/// <summary>Constructor</summary>
+		/// <param name="message">The specific error message, if desired</param>
+		explicit BacklogFullException(const char* message);
+
+		/// <summary>Constructor</summary>
+		/// <param name="message">The specific error message, if desired</param>
+		explicit BacklogFullException(const std::string& message);
+
+		virtual ~BacklogFullException();
+	};
+}
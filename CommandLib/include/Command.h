@@ -11,6 +11,7 @@
 #include <map>
 #include <vector>
 #include "Event.h"
+#include "Executor.h"
 #include <thread>
 
 /*! \mainpage CommandLib for C++
@@ -279,6 +280,23 @@ namespace CommandLib
 		/// <returns>The object that can waited up for this command to be signaled to abort.</returns>
 		/// <remarks>Note that this is signaled when the command should abort, which will be before the command finishes aborting itself</remarks>
 		Waitable::Ptr AbortEvent() const;
+
+		/// <summary>Specifies where this command, and every command it owns, runs its asynchronous work</summary>
+		/// <param name="executor">
+		/// The executor to use. Pass null to revert to <see cref="ThreadPool::Default"/>.
+		/// </param>
+		/// <remarks>
+		/// It is an error to call this on anything other than a top-level command. Owned commands always use the executor of
+		/// their top-level command. Changing the executor while the command is executing only affects work that has not yet
+		/// been scheduled.
+		/// </remarks>
+		void SetExecutor(Executor::Ptr executor);
+
+		/// <summary>The executor upon which this command runs its asynchronous work</summary>
+		/// <returns>
+		/// The executor set upon the top-level command of this command's tree, or <see cref="ThreadPool::Default"/> if none was set.
+		/// </returns>
+		Executor::Ptr GetExecutor() const;
 	protected:
 		/// <summary>
 		/// Constructor
@@ -330,9 +348,9 @@ namespace CommandLib
 		private:
 			ListenerProxy(const ListenerProxy&) = delete;
 			ListenerProxy& operator=(const ListenerProxy&) = delete;
+			void CheckNotLaunching(const char* callbackName) const;
 			Command* const m_command;
 			CommandListener* m_listener;
-			const std::thread::id m_asyncExeThreadId;
 		};
 
 		friend class AsyncCommand;
@@ -399,7 +417,9 @@ namespace CommandLib
 
 		std::shared_ptr<Event> m_abortEvent;
 		std::shared_ptr<Event> m_doneEvent = std::shared_ptr<Event>(new Event(true));
+		Executor::Ptr m_executor;
 
         mutable std::mutex m_mutex;
+		mutable std::mutex m_executorMutex;
 	};
 }
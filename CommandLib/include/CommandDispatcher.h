@@ -1,7 +1,22 @@
 ﻿#pragma once
 #include "Command.h"
-#include <queue>
+#include "DispatchHandle.h"
+#include "Event.h"
+#include "TokenBucket.h"
+#include "TimerService.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace CommandLib
 {
@@ -15,10 +30,81 @@ namespace CommandLib
 	/// Upon destruction, this object will wait until all dispatched commands finish execution. For a faster shutdown, you may wish to call
 	/// <see cref="CommandDispatcher::Abort()"/> before destructing the dispatcher.
 	/// </para>
+	/// <para>
+	/// This object is designed for heavy use by many threads at once. While there is room in the pool, dispatching a command takes
+	/// no lock that is shared by all threads; the priority queue is only consulted once the pool is full.
+	/// </para>
 	/// </remarks>
 	class CommandDispatcher
     {
 	public:
+		/// <summary>What to do with a dispatched command that must wait for room in the pool when the backlog is full</summary>
+		enum class OverflowPolicy
+		{
+			/// <summary>The dispatching thread waits until there is room in the backlog</summary>
+			Block,
+
+			/// <summary>The newly dispatched command is turned away</summary>
+			RejectNewest,
+
+			/// <summary>
+			/// The command that has been in the backlog longest is dropped to make room. It is never executed, and the
+			/// <see cref="CommandMonitor"/> subscribers are notified that it was aborted.
+			/// </summary>
+			DropOldest
+		};
+
+		/// <summary>Specifies how a dispatched command is to be scheduled</summary>
+		struct DispatchOptions
+		{
+			/// <summary>
+			/// Larger values are more urgent. Among the queued commands with the same tag, those of equal priority are executed in
+			/// the order they were dispatched.
+			/// </summary>
+			int priority = 0;
+
+			/// <summary>
+			/// Identifies the flow (for example, the tenant) that the command belongs to. Empty by default.
+			/// </summary>
+			/// <remarks>
+			/// Queued commands are kept separately per tag, and when the pool is full the tags take turns, in proportion to
+			/// the weights set by <see cref="SetTagWeight"/>. Priority decides which command goes next only within a tag. The
+			/// tag is also the group of commands that share a rate limit set by
+			/// <see cref="SetRateLimit(const std::string&amp;, double, double)"/>.
+			/// </remarks>
+			std::string tag;
+
+			/// <summary>
+			/// The time by which the command must have started, or it is not worth running. None by default.
+			/// </summary>
+			/// <remarks>
+			/// Among the queued commands of equal priority and tag, those with deadlines go first, earliest deadline first. With
+			/// aging (see <see cref="SetAgingInterval"/>), deadlines count as one step of aging, so that a steady stream of
+			/// commands with deadlines cannot starve the rest: a command without one goes first once it has waited an aging
+			/// interval longer than the command with the earliest deadline. A command whose deadline passes before it starts is never executed: it is removed, and the
+			/// <see cref="CommandMonitor"/> subscribers are notified that it failed with a <see cref="CommandTimeoutException"/>.
+			/// </remarks>
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+			/// <summary>
+			/// Commands dispatched with the same non-empty lane run one at a time, strictly in the order dispatched, as if each
+			/// lane were a <see cref="SequentialCommands"/> to which commands can be added while it runs. Empty by default.
+			/// </summary>
+			/// <remarks>
+			/// <para>
+			/// Different lanes run in parallel, within the limits of this dispatcher. A lane costs nothing while none of its
+			/// commands is dispatched, so there may be a lane per entity (for example, per account) even among millions of
+			/// entities.
+			/// </para>
+			/// <para>
+			/// A command waits in its lane until the command ahead of it has finished, and only then enters the backlog (where the
+			/// other options take effect). Waiting in a lane does not count against the backlog limit, and is never refused.
+			/// A command that fails, is aborted or expires does not stop the commands behind it.
+			/// </para>
+			/// </remarks>
+			std::string lane;
+		};
+
 		/// <summary>
 		/// Constructs a CommandDispatcher object
 		/// </summary>
@@ -29,6 +115,20 @@ namespace CommandLib
 		/// </param>
 		explicit CommandDispatcher(size_t maxConcurrent);
 
+		/// <summary>
+		/// Constructs a CommandDispatcher object
+		/// </summary>
+		/// <param name="maxConcurrent">
+		/// The maximum number of commands that can be executed concurrently by this dispatcher. If this
+		/// limit is reached, commands will be queued and only executed when enough prior dispatched commands
+		/// finish execution.
+		/// </param>
+		/// <param name="executor">
+		/// The executor upon which dispatched commands run their asynchronous work. Each dispatched command is assigned this
+		/// executor via <see cref="Command::SetExecutor"/>. If null, dispatched commands keep whatever executor they already have.
+		/// </param>
+		CommandDispatcher(size_t maxConcurrent, Executor::Ptr executor);
+
 		virtual ~CommandDispatcher();
 
 		/// <summary>Adds a listener that will receive callbacks about the status of commands executed by this dispatcher</summary>
@@ -43,14 +143,242 @@ namespace CommandLib
 		/// Note that it will cause undefined behavior to dispatch a <see cref="Command"/> object that is currently executing, or that has already been dispatched but has not yet executed.
 		/// </para>
 		/// </param>
+		/// <returns>A handle through which this execution can be followed, or cancelled</returns>
+		/// <remarks>
+		/// When the command evenutally finishes execution, the <see cref="CommandMonitor"/> subscribers will be notified on a different thread.
+		/// <para>
+		/// If the backlog is full (see <see cref="SetBacklogLimit"/>), this method waits for room, throws
+		/// <see cref="BacklogFullException"/>, or drops the oldest queued command, according to the overflow policy.
+		/// </para>
+		/// </remarks>
+		DispatchHandle Dispatch(Command::Ptr command);
+
+		/// <summary>
+		/// If there is room in the pool, asynchronously executes the command immediately. Otherwise, places the command in a queue for
+		/// processing when room in the pool becomes available. Queued commands of higher priority are executed first.
+		/// </summary>
+		/// <param name="command">
+		/// The command to execute as soon as there is room in the pool. The command must be top-level (that is, it must have no parent).
+		/// <para>
+		/// Note that it will cause undefined behavior to dispatch a <see cref="Command"/> object that is currently executing, or that has already been dispatched but has not yet executed.
+		/// </para>
+		/// </param>
+		/// <param name="priority">
+		/// Larger values are more urgent. Commands of equal priority are executed in the order they were dispatched.
+		/// <see cref="Dispatch(Command::Ptr)"/> uses a priority of zero.
+		/// </param>
+		/// <returns>A handle through which this execution can be followed, or cancelled</returns>
 		/// <remarks>
 		/// When the command evenutally finishes execution, the <see cref="CommandMonitor"/> subscribers will be notified on a different thread.
+		/// <para>
+		/// If the backlog is full (see <see cref="SetBacklogLimit"/>), this method waits for room, throws
+		/// <see cref="BacklogFullException"/>, or drops the oldest queued command, according to the overflow policy.
+		/// </para>
+		/// </remarks>
+		DispatchHandle Dispatch(Command::Ptr command, int priority);
+
+		/// <summary>
+		/// Same as <see cref="Dispatch(Command::Ptr, int)"/>, except that a command that would have to wait for room in a full backlog
+		/// is turned away rather than waited for
+		/// </summary>
+		/// <param name="command">The command to execute as soon as there is room in the pool. The command must be top-level.</param>
+		/// <param name="priority">Larger values are more urgent</param>
+		/// <returns>
+		/// False if the command was turned away, in which case it will not be executed and the monitors are not notified. Under the
+		/// <see cref="OverflowPolicy::DropOldest"/> policy, a command is never turned away.
+		/// </returns>
+		bool TryDispatch(Command::Ptr command, int priority = 0);
+
+		/// <summary>
+		/// If there is room in the pool (and the applicable rate limits allow), asynchronously executes the command immediately.
+		/// Otherwise, places the command in a queue for processing when it becomes possible.
+		/// </summary>
+		/// <param name="command">The command to execute as soon as possible. The command must be top-level.</param>
+		/// <param name="options">How the command is to be scheduled</param>
+		/// <returns>A handle through which this execution can be followed, or cancelled</returns>
+		/// <remarks>
+		/// If the backlog is full (see <see cref="SetBacklogLimit"/>), this method waits for room, throws
+		/// <see cref="BacklogFullException"/>, or drops the oldest queued command, according to the overflow policy.
+		/// </remarks>
+		DispatchHandle Dispatch(Command::Ptr command, const DispatchOptions& options);
+
+		/// <summary>
+		/// Same as <see cref="Dispatch(Command::Ptr, const DispatchOptions&amp;)"/>, except that a command that would have to wait
+		/// for room in a full backlog is turned away rather than waited for
+		/// </summary>
+		/// <param name="command">The command to execute as soon as possible. The command must be top-level.</param>
+		/// <param name="options">How the command is to be scheduled</param>
+		/// <returns>False if the command was turned away, in which case it will not be executed</returns>
+		bool TryDispatch(Command::Ptr command, const DispatchOptions& options);
+
+		/// <summary>
+		/// Same as <see cref="Dispatch(Command::Ptr, const DispatchOptions&amp;)"/>, except that under the
+		/// <see cref="OverflowPolicy::Block"/> policy, a full backlog is waited upon for a limited time only
+		/// </summary>
+		/// <param name="command">The command to execute as soon as possible. The command must be top-level.</param>
+		/// <param name="options">How the command is to be scheduled</param>
+		/// <param name="timeoutMS">The most milliseconds to wait for room in the backlog</param>
+		/// <returns>False if the command was turned away, in which case it will not be executed</returns>
+		bool Dispatch(Command::Ptr command, const DispatchOptions& options, long long timeoutMS);
+
+		/// <summary>
+		/// Same as <see cref="Dispatch(Command::Ptr, int)"/>, except that under the <see cref="OverflowPolicy::Block"/> policy, a
+		/// full backlog is waited upon for a limited time only
+		/// </summary>
+		/// <param name="command">The command to execute as soon as there is room in the pool. The command must be top-level.</param>
+		/// <param name="priority">Larger values are more urgent</param>
+		/// <param name="timeoutMS">The most milliseconds to wait for room in the backlog</param>
+		/// <returns>
+		/// False if the command was turned away, in which case it will not be executed and the monitors are not notified
+		/// </returns>
+		bool Dispatch(Command::Ptr command, int priority, long long timeoutMS);
+
+		/// <summary>
+		/// Same as <see cref="Dispatch(Command::Ptr, int)"/>, except that under the <see cref="OverflowPolicy::Block"/> policy, a
+		/// full backlog is waited upon for a limited time only
+		/// </summary>
+		/// <param name="command">The command to execute as soon as there is room in the pool. The command must be top-level.</param>
+		/// <param name="priority">Larger values are more urgent</param>
+		/// <param name="timeout">The most time to wait for room in the backlog</param>
+		/// <returns>
+		/// False if the command was turned away, in which case it will not be executed and the monitors are not notified
+		/// </returns>
+		template<typename Rep, typename Period>
+		bool Dispatch(Command::Ptr command, int priority, const std::chrono::duration<Rep, Period>& timeout)
+		{
+			return Dispatch(command, priority, std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
+		}
+
+		/// <summary>Limits how many commands may wait for room in the pool, so that a burst of work cannot exhaust memory</summary>
+		/// <param name="maxBacklog">The most commands that may be queued. Zero (the default) means no limit.</param>
+		/// <param name="policy">What to do with a dispatched command that must wait when the backlog is full</param>
+		/// <remarks>Lowering the limit below the current backlog does not remove any queued commands</remarks>
+		void SetBacklogLimit(size_t maxBacklog, OverflowPolicy policy);
+
+		/// <summary>
+		/// Sets the backlog sizes at which <see cref="BacklogHighEvent"/> and <see cref="BacklogLowEvent"/> change state
+		/// </summary>
+		/// <param name="lowWatermark">Once the backlog shrinks to this size, the low event is signaled and the high event is reset</param>
+		/// <param name="highWatermark">
+		/// Once the backlog grows to this size, the high event is signaled and the low event is reset. Must be greater than
+		/// lowWatermark.
+		/// </param>
+		/// <remarks>
+		/// Between the two watermarks, the events keep the state they had, so that a backlog hovering around one of them does not
+		/// make the events flicker. Until this method is called, the high event is never signaled.
+		/// </remarks>
+		void SetBacklogWatermarks(size_t lowWatermark, size_t highWatermark);
+
+		/// <summary>Signaled while the backlog is above its high watermark (see <see cref="SetBacklogWatermarks"/>)</summary>
+		/// <returns>The object that producers can wait upon, or add to a <see cref="WaitGroup"/>, to learn of congestion</returns>
+		Waitable::Ptr BacklogHighEvent() const;
+
+		/// <summary>Signaled while the backlog is below its low watermark (see <see cref="SetBacklogWatermarks"/>)</summary>
+		/// <returns>The object that a throttled producer can wait upon before it resumes</returns>
+		Waitable::Ptr BacklogLowEvent() const;
+
+		/// <summary>
+		/// Makes queued commands gain priority the longer they wait, so that a steady stream of more urgent commands cannot starve
+		/// the rest
+		/// </summary>
+		/// <param name="intervalMS">
+		/// A queued command's priority is raised by one for every interval of this many milliseconds it has waited. Zero (the
+		/// default) means priorities never change.
+		/// </param>
+		void SetAgingInterval(long long intervalMS);
+
+		/// <summary>
+		/// Makes queued commands gain priority the longer they wait, so that a steady stream of more urgent commands cannot starve
+		/// the rest
+		/// </summary>
+		/// <param name="interval">
+		/// A queued command's priority is raised by one for every interval of this length it has waited. Zero (the default) means
+		/// priorities never change.
+		/// </param>
+		template<typename Rep, typename Period>
+		void SetAgingInterval(const std::chrono::duration<Rep, Period>& interval)
+		{
+			SetAgingInterval(std::chrono::duration_cast<std::chrono::milliseconds>(interval).count());
+		}
+
+		/// <summary>
+		/// Lets the concurrency limit follow the capacity of whatever the dispatched commands depend upon, rather than stay at the
+		/// value given upon construction
+		/// </summary>
+		/// <param name="minConcurrent">The limit never falls below this. Must be greater than zero.</param>
+		/// <param name="maxConcurrent">The limit never rises above this. Must be no less than minConcurrent.</param>
+		/// <param name="latencyTolerance">
+		/// How many times slower than the fastest recently observed execution commands may become before the limit is lowered.
+		/// Must be greater than 1.
+		/// </param>
+		/// <remarks>
+		/// <para>
+		/// The limit is adjusted as commands finish, in the manner of TCP congestion control (additive increase, multiplicative
+		/// decrease). While the pool is well used and commands complete about as quickly as they do without load, the limit grows
+		/// by one for every limit's worth of completions. When execution times rise past the tolerance, or commands fail, the
+		/// downstream service is taken to be overloaded, and the limit is cut by a tenth. Only one cut is made for each round of
+		/// commands, since those already running were started at the old limit.
+		/// </para>
+		/// <para>
+		/// Aborted commands are not taken into account. The limit starts at the value given upon construction (kept within
+		/// bounds).
+		/// </para>
+		/// </remarks>
+		void SetAdaptiveConcurrency(size_t minConcurrent, size_t maxConcurrent, double latencyTolerance = 2.0);
+
+		/// <summary>Limits the rate at which this dispatcher starts commands</summary>
+		/// <param name="startsPerSecond">
+		/// The most commands to start per second, on average. Zero removes the limit. Must not be negative.
+		/// </param>
+		/// <param name="burst">
+		/// The most commands that may be started at once after a quiet spell. Must be at least 1, unless startsPerSecond is zero.
+		/// </param>
+		/// <remarks>
+		/// This limit applies in addition to the limit on concurrency. Commands that are held back wait in the backlog, and are
+		/// released by a timer as the rate allows, rather than all at once when earlier commands finish.
+		/// </remarks>
+		void SetRateLimit(double startsPerSecond, double burst);
+
+		/// <summary>Limits the rate at which this dispatcher starts the commands dispatched with the given tag</summary>
+		/// <param name="tag">The tag given in the <see cref="DispatchOptions"/> of the commands to limit</param>
+		/// <param name="startsPerSecond">
+		/// The most commands with this tag to start per second, on average. Zero removes the limit. Must not be negative.
+		/// </param>
+		/// <param name="burst">
+		/// The most commands with this tag that may be started at once after a quiet spell. Must be at least 1, unless
+		/// startsPerSecond is zero.
+		/// </param>
+		/// <remarks>
+		/// This limit applies in addition to the dispatcher-wide limits. Commands held back by it do not hold up commands
+		/// with other tags.
+		/// </remarks>
+		void SetRateLimit(const std::string& tag, double startsPerSecond, double burst);
+
+		/// <summary>Sets the share of the pool that the commands with the given tag receive while the pool is full</summary>
+		/// <param name="tag">The tag given in the <see cref="DispatchOptions"/> of the commands</param>
+		/// <param name="weight">
+		/// The number of commands with this tag to start each time the tags take turns. It need not be a whole number (a weight of
+		/// 0.5 gets a turn every other round). Must be greater than zero. The default weight is 1.
+		/// </param>
+		/// <remarks>
+		/// Queued tags are served by deficit round robin, so that a tag with a great many commands queued delays the other tags
+		/// by no more than its share, regardless of how quickly it dispatches them.
 		/// </remarks>
-		void Dispatch(Command::Ptr command);
+		void SetTagWeight(const std::string& tag, double weight);
+
+		/// <summary>The current limit on the number of commands executed concurrently</summary>
+		/// <returns>
+		/// The value given upon construction, unless <see cref="SetAdaptiveConcurrency"/> has been called
+		/// </returns>
+		size_t ConcurrencyLimit() const;
 
 		/// <summary>
 		/// Aborts all dispatched commands, and empties the queue of not yet executed commands.
 		/// </summary>
+		/// <remarks>
+		/// The monitors are not notified of the commands removed from the queue, but their <see cref="DispatchHandle"/> objects
+		/// report them as aborted.
+		/// </remarks>
 		void Abort();
 
 		/// <summary>
@@ -65,29 +393,191 @@ namespace CommandLib
 	private:
 		CommandDispatcher(const CommandDispatcher&) = delete;
 		CommandDispatcher& operator= (const CommandDispatcher&) = delete;
-		void OnCommandFinished(Command::Ptr command, const std::exception* exc);
+
+		// Null for commands dispatched by the methods that return no handle, which then cost nothing extra
+		typedef std::shared_ptr<DispatchHandle::State> HandleState;
 
         class Listener : public CommandListener
         {
 		public:
-			Listener(CommandDispatcher* dispatcher, Command::Ptr command);
+			Listener(CommandDispatcher* dispatcher, Command::Ptr command, const std::string& lane, const HandleState& handle);
 			virtual void CommandSucceeded() override final;
 			virtual void CommandAborted() override final;
 			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
 
+			Command::Ptr m_command;
+			std::chrono::steady_clock::time_point m_startTime;
+			const std::string m_lane;
+			const HandleState m_handle;
+
+			// Links within the list of running commands of the shard that launched the command
+			size_t m_shard = 0;
+			Listener* m_previous = nullptr;
+			Listener* m_next = nullptr;
 		private:
 			Listener(const Listener&) = delete;
 			Listener& operator=(const Listener&) = delete;
-			Command::Ptr m_command;
             CommandDispatcher* const m_dispatcher;
 		};
 
+		// Running commands are tracked in several independently locked lists, chosen by the dispatching thread, so that
+		// dispatching and finishing upon different threads rarely contend
+		struct Shard
+		{
+			std::mutex mutex;
+			Listener* running = nullptr;
+
+			// A command cannot be released from within its own completion callback, because it is not quite done executing.
+			// Finished commands are held here until their done events are signaled.
+			std::deque<Command::Ptr> finished;
+		};
+
+		bool TryAcquireSlot();
+		void Launch(Listener* listener);
+		void Unlink(Shard& shard, Listener* listener);
+		void Pump();
+		enum class Admission { Accepted, Rejected, Discarded };
+
+		bool DispatchImpl(Command::Ptr command, const DispatchOptions& options, long long timeoutMS, const HandleState& handle);
+		Admission Admit(
+			Command::Ptr command, const DispatchOptions& options, long long timeoutMS, bool bypassLimit, const HandleState& handle);
+		void AdvanceLane(const std::string& lane);
+		struct QueuedCommand;
+		QueuedCommand PopOldest();
+		void ScheduleRelease(long long ms);
+		bool CancelRelease();
+		void OnReleaseTimer(unsigned long long generation);
+		static std::unique_ptr<TokenBucket> CreateBucket(double startsPerSecond, double burst);
+		void UpdateWatermarks();
+		void AdjustLimit(const Listener* listener, const std::exception* exc);
+		void OnCommandFinished(Listener* listener, const std::exception* exc, std::exception_ptr excPtr);
+		void AddOutstanding();
+		void RemoveOutstanding(size_t count);
+		bool PopBacklog(QueuedCommand& next, long long& retryMS, std::vector<QueuedCommand>& expired);
+		void ReportFinished(const Command& command, const HandleState& handle, const std::exception* exc, std::exception_ptr excPtr);
+		void ReportExpired(const Command& command, const HandleState& handle);
+		void ReportCancelled(const Command& command, const HandleState& handle);
+
         const size_t m_maxConcurrent;
+		const Executor::Ptr m_executor;
 		std::list<CommandMonitor*> m_monitors;
-        std::vector<Command::Ptr> m_runningCommands;
-		std::queue<Command::Ptr> m_commandBacklog;
-		std::list<Command::Ptr> m_finishedCommands;
+		std::vector<std::unique_ptr<Shard>> m_shards;
+
+		// The number of commands running, or about to be. New commands are only started while this is below m_limit.
+		std::atomic_size_t m_runningCount;
+		std::atomic_size_t m_limit;
+
+		// The state of the adaptive limit. Until it is made adaptive, finishing commands neither time themselves nor take the lock.
+		std::atomic_bool m_adaptive;
+		size_t m_minLimit = 0;
+		size_t m_maxLimit = 0;
+		double m_latencyTolerance = 0;
+		double m_baselineUS = 0;
+		double m_smoothedUS = 0;
+		double m_increaseCredit = 0;
+		std::chrono::steady_clock::time_point m_lastDecrease;
+		std::mutex m_limitMutex;
+
+		// The number of dispatched commands that have not yet finished, including those in the backlog
+		std::atomic_size_t m_outstandingCount;
         Event m_nothingToDoEvent;
-		std::mutex m_mutex;
+		std::mutex m_idleMutex;
+
+		// The backlog is only touched when the concurrency limit has been reached, or when start rates are limited
+		struct QueuedCommand
+		{
+			Command::Ptr command;
+			std::chrono::steady_clock::time_point queuedTime;
+			unsigned long long sequence;
+			std::chrono::steady_clock::time_point deadline;
+			std::string lane;
+			HandleState handle;
+
+			bool operator<(const QueuedCommand& other) const;
+		};
+
+		// The commands of one priority within one flow. Those with deadlines go first, earliest deadline first (unless the rest
+		// have aged past them), and the rest in the order dispatched. The latter are kept apart so that they are queued at no
+		// more cost than without deadlines.
+		struct PriorityLevel
+		{
+			std::set<QueuedCommand> dated;
+			std::deque<QueuedCommand> undated;
+
+			// The dated commands in the order dispatched, so that the one that has waited longest can be found
+			std::map<unsigned long long, std::set<QueuedCommand>::iterator> datedBySequence;
+
+			void Push(QueuedCommand&& queued);
+			bool UndatedFirst(long long agingIntervalMS) const;
+			const QueuedCommand& Front(long long agingIntervalMS) const;
+			void PopFront(long long agingIntervalMS);
+			const QueuedCommand& Oldest() const;
+			void PopOldest();
+			void RemoveExpired(std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired);
+			void EraseDated(std::set<QueuedCommand>::iterator position);
+			bool Empty() const;
+			size_t Size() const;
+		};
+
+		// Keyed by priority, most urgent first. Each level is removed once empty.
+		typedef std::map<int, PriorityLevel, std::greater<int>> PriorityLevels;
+
+		PriorityLevels::iterator MostUrgentLevel(PriorityLevels& levels, std::chrono::steady_clock::time_point now, long long& priority);
+
+		// Commands are queued separately per tag, so that one tag cannot crowd out the others, and a tag whose rate is used up
+		// does not hold them up
+		struct Flow
+		{
+			const std::string* tag = nullptr;
+			PriorityLevels levels;
+			double weight = 1;
+			double deficit = 0;
+			std::list<Flow*>::iterator position;
+		};
+
+		void RemoveFlow(Flow* flow);
+		bool RemoveExpired(Flow* flow, std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired);
+		void PurgeExpired(std::chrono::steady_clock::time_point now, std::vector<QueuedCommand>& expired);
+		void DiscardExpired(const std::vector<QueuedCommand>& expired);
+
+		// Only tags with commands queued have flows. They take turns in the order of m_activeFlows.
+		std::unordered_map<std::string, Flow> m_flows;
+		std::list<Flow*> m_activeFlows;
+		std::unordered_map<std::string, double> m_tagWeights;
+		std::atomic_size_t m_backlogCount;
+		unsigned long long m_nextSequence = 0;
+
+		// No queued command has a deadline before this. It may be earlier than the earliest deadline actually queued (since
+		// commands leave the backlog without updating it), but never later.
+		std::chrono::steady_clock::time_point m_earliestDeadline = std::chrono::steady_clock::time_point::max();
+
+		std::unique_ptr<TokenBucket> m_rateBucket;
+		std::unordered_map<std::string, std::unique_ptr<TokenBucket>> m_tagBuckets;
+		std::atomic_bool m_rateLimited;
+		TimerService::TimerId m_releaseTimerId = 0;
+		std::chrono::steady_clock::time_point m_releaseDue;
+		unsigned long long m_releaseGeneration = 0;
+		long long m_agingIntervalMS = 0;
+		size_t m_maxBacklog = 0;
+		OverflowPolicy m_overflowPolicy = OverflowPolicy::Block;
+		size_t m_blockedDispatchers = 0;
+		size_t m_lowWatermark = 0;
+		size_t m_highWatermark = 0;
+		const std::shared_ptr<Event> m_backlogHighEvent = std::shared_ptr<Event>(new Event(false));
+		const std::shared_ptr<Event> m_backlogLowEvent = std::shared_ptr<Event>(new Event(true));
+		std::mutex m_backlogMutex;
+
+		// Keyed by lane. A lane is present while one of its commands is in the backlog or running, and holds the commands
+		// waiting behind that one.
+		struct LanedCommand
+		{
+			Command::Ptr command;
+			DispatchOptions options;
+			HandleState handle;
+		};
+
+		std::unordered_map<std::string, std::deque<LanedCommand>> m_lanes;
+		std::mutex m_laneMutex;
+		std::condition_variable m_backlogRoom;
 	};
 }
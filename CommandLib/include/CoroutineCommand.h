@@ -0,0 +1,134 @@
+#pragma once
+#include "AsyncCommand.h"
+#include <coroutine>
+#include <exception>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// The object produced by applying co_await to a <see cref="Command"/>. It launches the command via
+	/// <see cref="Command::AsyncExecute"/> and resumes the awaiting coroutine when the command finishes.
+	/// </summary>
+	/// <remarks>
+	/// The coroutine is resumed upon the awaited command's <see cref="Executor"/>, never upon the thread that informs the
+	/// listener, so it is safe to await the same command again right away. If the command fails, co_await throws the
+	/// reason for failure. If the command is aborted, co_await throws a <see cref="CommandAbortedException"/>.
+	/// </remarks>
+	class CommandAwaiter : private CommandListener
+	{
+	public:
+		/// <summary>Constructor</summary>
+		/// <param name="command">The command to execute when awaited</param>
+		explicit CommandAwaiter(Command::Ptr command);
+
+		/// <summary>Part of the awaiter protocol. Always false, because the command has not yet been launched.</summary>
+		bool await_ready() const noexcept;
+
+		/// <summary>Part of the awaiter protocol. Launches the command.</summary>
+		/// <param name="awaiting">The coroutine to resume when the command finishes</param>
+		void await_suspend(std::coroutine_handle<> awaiting);
+
+		/// <summary>Part of the awaiter protocol. Throws if the command did not succeed.</summary>
+		void await_resume() const;
+	private:
+		virtual void CommandSucceeded() override final;
+		virtual void CommandAborted() override final;
+		virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+
+		void Resume();
+
+		Command::Ptr m_command;
+		std::coroutine_handle<> m_awaiting;
+		std::exception_ptr m_exception;
+	};
+
+	/// <summary>Allows a coroutine to co_await the execution of any <see cref="Command"/></summary>
+	/// <param name="command">The command to execute</param>
+	/// <returns>The awaiter, which launches the command</returns>
+	CommandAwaiter operator co_await(Command::Ptr command);
+
+	/// <summary>
+	/// Represents a <see cref="Command"/> whose implementation is a coroutine. Long sequences of logic can co_await other commands
+	/// without tying up a thread while they execute.
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Implement <see cref="ExecuteCoroutine"/>. The coroutine is started upon this command's <see cref="Executor"/>. Returning
+	/// normally means success; an escaping exception means failure, unless it is a <see cref="CommandAbortedException"/>, in
+	/// which case the command is considered aborted. Call <see cref="Command::CheckAbortFlag"/> between awaits to respond to
+	/// abort requests.
+	/// </para>
+	/// <para>
+	/// Awaited commands that this object owns (see <see cref="Command::TakeOwnership"/>) are aborted along with this command.
+	/// Awaited top-level commands are not.
+	/// </para>
+	/// </remarks>
+	class CoroutineCommand : public AsyncCommand
+	{
+	public:
+		/// <summary>The return type of <see cref="ExecuteCoroutine"/></summary>
+		class Task
+		{
+		public:
+			/// <summary>Part of the coroutine protocol</summary>
+			class promise_type
+			{
+			public:
+				/// <summary>Part of the coroutine protocol</summary>
+				Task get_return_object();
+
+				/// <summary>Part of the coroutine protocol. The coroutine does not run until the command is executed.</summary>
+				std::suspend_always initial_suspend() const noexcept;
+
+				/// <summary>Part of the coroutine protocol. Informs the command's listener of the outcome.</summary>
+				auto final_suspend() noexcept
+				{
+					struct FinalAwaiter
+					{
+						bool await_ready() const noexcept { return false; }
+						void await_suspend(std::coroutine_handle<promise_type> finished) noexcept { OnFinished(finished); }
+						void await_resume() const noexcept {}
+					};
+
+					return FinalAwaiter();
+				}
+
+				/// <summary>Part of the coroutine protocol</summary>
+				void return_void() const noexcept;
+
+				/// <summary>Part of the coroutine protocol</summary>
+				void unhandled_exception() noexcept;
+			private:
+				friend class CoroutineCommand;
+				static void OnFinished(std::coroutine_handle<promise_type> finished) noexcept;
+
+				Command::Ptr m_command;
+				std::exception_ptr m_exception;
+			};
+
+			/// <summary>Move constructor</summary>
+			Task(Task&& other) noexcept;
+
+			/// <summary>Destroys the coroutine if it was never started</summary>
+			~Task();
+		private:
+			friend class CoroutineCommand;
+			explicit Task(std::coroutine_handle<promise_type> handle);
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+
+			std::coroutine_handle<promise_type> m_handle;
+		};
+	protected:
+		/// <summary>
+		/// Implementations should override this with a coroutine that performs the work of the command
+		/// </summary>
+		/// <returns>The coroutine's task. Implementations simply co_await and co_return; the task is created by the compiler.</returns>
+		virtual Task ExecuteCoroutine() = 0;
+	private:
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+		void OnCoroutineFinished(std::exception_ptr exc);
+
+		CommandListener* m_listener = nullptr;
+	};
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "Command.h"
+#include "Event.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+namespace CommandLib
+{
+	class CommandDispatcher;
+
+	/// <summary>
+	/// Follows a single command dispatched by a <see cref="CommandDispatcher"/>, so that its outcome can be learned (and its
+	/// execution cancelled) without a <see cref="CommandMonitor"/> that sees every command
+	/// </summary>
+	/// <remarks>
+	/// Copies of a handle refer to the same dispatch. A handle does not keep its command alive: once the dispatcher is done with
+	/// the command, the command lives only as long as the caller holds it. This object is thread safe.
+	/// </remarks>
+	class DispatchHandle
+	{
+	public:
+		/// <summary>What became of the dispatched command</summary>
+		enum class Outcome
+		{
+			/// <summary>The command has not yet finished (or been discarded)</summary>
+			Pending,
+
+			/// <summary>The command executed successfully</summary>
+			Succeeded,
+
+			/// <summary>
+			/// The command failed, or could not be started, or was discarded because its deadline passed before it could start
+			/// </summary>
+			Failed,
+
+			/// <summary>The command was aborted, or was discarded before it started (for example, by a cancellation)</summary>
+			Aborted
+		};
+
+		/// <summary>Constructs a handle that refers to no dispatch</summary>
+		DispatchHandle();
+
+		/// <summary>Whether this handle refers to a dispatch</summary>
+		/// <returns>false for a default-constructed handle</returns>
+		bool IsValid() const;
+
+		/// <summary>What became of the dispatched command so far</summary>
+		/// <returns><see cref="Outcome::Pending"/> until the command is finished with</returns>
+		Outcome GetOutcome() const;
+
+		/// <summary>Signaled once the dispatcher is finished with the command, however that came about</summary>
+		/// <returns>The object that can be waited upon, or added to a <see cref="WaitGroup"/></returns>
+		Waitable::Ptr DoneEvent() const;
+
+		/// <summary>Waits until the dispatcher is finished with the command</summary>
+		void Wait() const;
+
+		/// <summary>Waits until the dispatcher is finished with the command, or until the given time elapses</summary>
+		/// <param name="milliseconds">The most milliseconds to wait</param>
+		/// <returns>true if the dispatcher is finished with the command</returns>
+		bool Wait(long long milliseconds) const;
+
+		/// <summary>Waits until the dispatcher is finished with the command, or until the given time elapses</summary>
+		/// <param name="duration">The most time to wait</param>
+		/// <returns>true if the dispatcher is finished with the command</returns>
+		template<typename Rep, typename Period>
+		bool Wait(const std::chrono::duration<Rep, Period>& duration) const
+		{
+			return Wait(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+		}
+
+		/// <summary>Waits until the dispatcher is finished with the command, and reports how that went</summary>
+		/// <remarks>
+		/// Returns normally if the command succeeded. Otherwise, throws the exception that the command failed with, or
+		/// <see cref="CommandAbortedException"/> if it was aborted or discarded.
+		/// </remarks>
+		void Get() const;
+
+		/// <summary>The reason the command did not succeed</summary>
+		/// <returns>Null if the command succeeded, or has not yet finished</returns>
+		std::exception_ptr Error() const;
+
+		/// <summary>Cancels execution of the command</summary>
+		/// <remarks>
+		/// If the command has not yet started, it never will: it is discarded when its turn comes, and reported as aborted. If
+		/// it is executing, it is aborted. If it has finished, this has no effect.
+		/// </remarks>
+		void Cancel();
+	private:
+		friend class CommandDispatcher;
+
+		struct State
+		{
+			Event doneEvent;
+			std::atomic<Outcome> outcome{ Outcome::Pending };
+			std::exception_ptr error;
+			std::weak_ptr<Command> command;
+			std::atomic_bool cancelled{ false };
+
+			void Complete(const std::exception* exc, std::exception_ptr excPtr);
+		};
+
+		explicit DispatchHandle(std::shared_ptr<State> state);
+
+		std::shared_ptr<State> m_state;
+	};
+}
@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include "WaitMonitor.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <set>
 #include <condition_variable>
@@ -51,8 +53,20 @@ namespace CommandLib
 	private:
 		Event(const Event&);
 		Event& operator=(const Event&) = delete;
-		bool m_signaled;
-		mutable std::condition_variable_any m_condition;
-		mutable std::recursive_mutex m_mutex;
+
+		// m_state holds the signaled flag, plus a flag that says whether any thread may be sleeping in Wait(). The latter lets
+		// Set() skip the wakeup when nobody is waiting. On Linux, waiting threads sleep on m_state itself via futex.
+		static const uint32_t Signaled = 1;
+		static const uint32_t HasWaiters = 2;
+
+		bool WaitUntil(const std::chrono::steady_clock::time_point* deadline) const;
+		void WakeWaiters();
+
+		mutable std::atomic<uint32_t> m_state;
+		std::atomic_int m_notifying;
+#ifndef __linux__
+		mutable std::condition_variable m_condition;
+		mutable std::mutex m_mutex;
+#endif
 	};
 }
@@ -0,0 +1,56 @@
+#pragma once
+#ifdef __linux__
+#include "FdWaitable.h"
+
+namespace CommandLib
+{
+	/// <summary>
+	/// A manual reset event, like <see cref="Event"/>, that is backed by a Linux eventfd. Its descriptor can also be handed to
+	/// code outside this library (another epoll loop, or a child process) that needs to wait upon or signal the event.
+	/// </summary>
+	/// <remarks>
+	/// Unlike <see cref="Event"/>, listeners are informed upon the thread of the default <see cref="Reactor"/>, shortly after
+	/// <see cref="Set"/> returns.
+	/// </remarks>
+	class EventFdWaitable : public FdWaitable
+	{
+	public:
+		/// <summary>Shared pointer to a non-modifyable EventFdWaitable object</summary>
+		typedef std::shared_ptr<const EventFdWaitable> ConstPtr;
+
+		/// <summary>Shared pointer to an EventFdWaitable object</summary>
+		typedef std::shared_ptr<EventFdWaitable> Ptr;
+
+		/// <summary>Creates an unsignaled EventFdWaitable</summary>
+		/// <exception cref="std::system_error">The eventfd could not be created or watched</exception>
+		static Ptr Create();
+
+		/// <summary>Creates an EventFdWaitable</summary>
+		/// <param name="initiallySignaled">Whether the event should be initially signaled</param>
+		/// <exception cref="std::system_error">The eventfd could not be created or watched</exception>
+		static Ptr Create(bool initiallySignaled);
+
+		/// <summary>Signal this event</summary>
+		/// <remarks>
+		/// This object will stay signaled until <see cref="Reset"/> is called. It is safe to call this multiple times in a row.
+		/// </remarks>
+		void Set();
+
+		/// <summary>Make this event not signaled</summary>
+		/// <remarks>
+		/// This object will stay not signaled until <see cref="Set"/> is called. It is safe to call this multiple times in a row.
+		/// </remarks>
+		void Reset();
+
+		/// <summary>The eventfd descriptor, which remains owned by this object</summary>
+		int Fd() const;
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		explicit EventFdWaitable(bool initiallySignaled);
+	private:
+		static int CreateEventFd(bool initiallySignaled);
+	};
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include <functional>
+#include <memory>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// Defines where asynchronous work is run. An Executor may be attached to a top-level <see cref="Command"/> via
+	/// <see cref="Command::SetExecutor"/>, in which case that command and every command it owns schedule their asynchronous
+	/// work upon it.
+	/// </summary>
+	/// <remarks>
+	/// <see cref="ThreadPool"/> is the implementation used when no other is specified. Implement this interface yourself if you
+	/// need more control (for example, to run work upon threads that are pinned to particular processors).
+	/// </remarks>
+	class Executor
+	{
+	public:
+		/// <summary>Shared pointer to an Executor object</summary>
+		typedef std::shared_ptr<Executor> Ptr;
+
+		virtual ~Executor();
+
+		/// <summary>Arranges for the given work to be run</summary>
+		/// <param name="task">The work to run. It will not throw.</param>
+		/// <remarks>
+		/// Implementations must not run the task from within this call, because <see cref="CommandListener"/> callbacks are
+		/// made from these tasks, and those callbacks must never be made from within <see cref="Command::AsyncExecute"/>.
+		/// Implementations must also not let a task wait indefinitely behind other tasks that are blocked, because the
+		/// synchronous implementations of commands may block upon work that is queued behind them.
+		/// </remarks>
+		virtual void Execute(std::function<void()> task) = 0;
+
+		/// <summary>Whether the calling thread is one of the threads upon which this executor runs its work</summary>
+		/// <returns>
+		/// True if work that would otherwise be handed off via <see cref="Execute"/> may instead be run upon the calling thread.
+		/// This implementation returns false. Override it if your threads may run (and block upon) commands directly.
+		/// </returns>
+		/// <remarks>
+		/// Commands use this to run their next step inline when a step finishes upon one of the executor's threads, rather than
+		/// handing it off, while never blocking a thread the executor does not own (such as that of the <see cref="TimerService"/>).
+		/// </remarks>
+		virtual bool IsWorkerThread() const;
+	};
+}
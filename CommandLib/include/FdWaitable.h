@@ -0,0 +1,86 @@
+#pragma once
+#ifdef __linux__
+#include "Waitable.h"
+#include "Reactor.h"
+
+namespace CommandLib
+{
+	/// <summary>
+	/// A <see cref="Waitable"/> that is signaled while a file descriptor (such as a socket or a pipe) is readable or writable.
+	/// It can be added to a <see cref="WaitGroup"/>, or passed as the stop event of a <see cref="PauseCommand"/>, so that
+	/// commands can wait upon I/O without a thread blocked upon each descriptor.
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Listeners are informed upon the thread of the default <see cref="Reactor"/> each time the descriptor becomes ready.
+	/// <see cref="IsSignaled"/> and the Wait() methods ask the kernel directly.
+	/// </para>
+	/// <para>
+	/// This object watches a duplicate of the descriptor it was given, so several objects may watch the same descriptor.
+	/// The underlying file is not closed until this object is destroyed.
+	/// </para>
+	/// </remarks>
+	class FdWaitable : public Waitable
+	{
+	public:
+		/// <summary>The condition under which an FdWaitable is signaled</summary>
+		enum class Condition
+		{
+			/// <summary>Signaled when reading will not block</summary>
+			Readable,
+
+			/// <summary>Signaled when writing will not block</summary>
+			Writable
+		};
+
+		/// <summary>Shared pointer to a non-modifyable FdWaitable object</summary>
+		typedef std::shared_ptr<const FdWaitable> ConstPtr;
+
+		/// <summary>Shared pointer to an FdWaitable object</summary>
+		typedef std::shared_ptr<FdWaitable> Ptr;
+
+		/// <summary>Creates an FdWaitable</summary>
+		/// <param name="fd">The file descriptor to watch. The caller keeps ownership of it.</param>
+		/// <param name="condition">Whether to watch for the descriptor becoming readable or writable</param>
+		/// <exception cref="std::system_error">The descriptor could not be duplicated or watched</exception>
+		static Ptr Create(int fd, Condition condition);
+
+		virtual ~FdWaitable();
+
+		/// <summary>Whether this object watches for the descriptor becoming readable or writable</summary>
+		Condition GetCondition() const;
+
+		/// <inheritdoc/>
+		/// <remarks>An error or hangup upon the descriptor also counts as signaled, since I/O will not block</remarks>
+		virtual bool IsSignaled() const override;
+
+		/// <inheritdoc/>
+		virtual void Wait() const override;
+
+		/// <inheritdoc/>
+		virtual bool Wait(long long ms) const override;
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		/// <param name="ownedFd">The file descriptor to watch. This object takes ownership of it.</param>
+		/// <param name="condition">Whether to watch for the descriptor becoming readable or writable</param>
+		FdWaitable(int ownedFd, Condition condition);
+
+		/// <summary>Registers a newly created object with the default <see cref="Reactor"/></summary>
+		/// <param name="waitable">The object to register. Create() methods must call this before returning the object.</param>
+		static void StartWatching(const Ptr& waitable);
+
+		/// <summary>The descriptor that this object watches and owns</summary>
+		const int m_fd;
+	private:
+		FdWaitable(const FdWaitable&) = delete;
+		FdWaitable& operator=(const FdWaitable&) = delete;
+
+		bool Poll(int timeoutMS) const;
+
+		const Condition m_condition;
+		Reactor::WatchId m_watchId;
+	};
+}
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+#include "AsyncCommand.h"
+#include "LatencyHistogram.h"
+#include "TimerService.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// This <see cref="Command"/> runs one of several equivalent commands and, if no result has arrived after a while, starts
+	/// another as a backup ("hedges"). Whichever succeeds first is taken, and the others are aborted.
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Hedging reduces tail latency when an occasional attempt is slow for reasons that have nothing to do with the request itself
+	/// (a slow replica, a pause in the server, a lost packet). The delay before hedging adapts to the latencies observed: once
+	/// enough successful executions have been timed (from the start of the first attempt, however many attempts they took), it
+	/// is the given percentile of the recent latencies, so that only the slowest few percent of executions are hedged and little
+	/// extra load is added.
+	/// </para>
+	/// <para>
+	/// If an attempt fails, the next is started right away rather than after the delay. This object fails only if every attempt
+	/// fails, and reports the first failure reason. No thread is consumed while waiting to hedge; the delay is tracked by
+	/// <see cref="TimerService::Default"/>, and backups are launched upon the command's <see cref="Executor"/>.
+	/// </para>
+	/// </remarks>
+	class HedgedCommand : public AsyncCommand
+	{
+	public:
+		/// <summary>Shared pointer to a non-modifyable HedgedCommand object</summary>
+		typedef std::shared_ptr<const HedgedCommand> ConstPtr;
+
+		/// <summary>Shared pointer to a HedgedCommand object</summary>
+		typedef std::shared_ptr<HedgedCommand> Ptr;
+
+		/// <summary>Creates the commands to run. Each call must return a new command that does the equivalent work.</summary>
+		typedef std::function<Command::Ptr()> CommandFactory;
+
+		/// <summary>
+		/// Creates a HedgedCommand that runs up to two attempts, and hedges at the 95th percentile of the observed latencies
+		/// </summary>
+		/// <param name="factory">
+		/// Called once per attempt, upon creation. This object takes ownership of the returned commands, so they must not already
+		/// have an owner.
+		/// </param>
+		/// <param name="initialDelayMS">
+		/// The number of milliseconds to wait before hedging, until enough latencies have been observed to choose the delay
+		/// </param>
+		static Ptr Create(const CommandFactory& factory, long long initialDelayMS);
+
+		/// <summary>
+		/// Creates a HedgedCommand that runs up to two attempts, and hedges at the 95th percentile of the observed latencies
+		/// </summary>
+		/// <param name="factory">
+		/// Called once per attempt, upon creation. This object takes ownership of the returned commands, so they must not already
+		/// have an owner.
+		/// </param>
+		/// <param name="initialDelay">
+		/// The time to wait before hedging, until enough latencies have been observed to choose the delay
+		/// </param>
+		template<typename Rep, typename Period>
+		static Ptr Create(const CommandFactory& factory, const std::chrono::duration<Rep, Period>& initialDelay)
+		{
+			return Create(factory, std::chrono::duration_cast<std::chrono::milliseconds>(initialDelay).count());
+		}
+
+		/// <summary>Creates a HedgedCommand</summary>
+		/// <param name="factory">
+		/// Called once per attempt, upon creation. This object takes ownership of the returned commands, so they must not already
+		/// have an owner.
+		/// </param>
+		/// <param name="maxAttempts">
+		/// The most attempts to run per execution, including the first. Each backup waits the hedging delay after the previous
+		/// attempt started. Must be greater than zero.
+		/// </param>
+		/// <param name="initialDelayMS">
+		/// The number of milliseconds to wait before hedging, until enough latencies have been observed to choose the delay
+		/// </param>
+		/// <param name="percentile">
+		/// The percentile of the observed latencies after which to hedge (e.g. 95 or 99). Must be greater than 0 and no greater
+		/// than 100.
+		/// </param>
+		static Ptr Create(const CommandFactory& factory, size_t maxAttempts, long long initialDelayMS, double percentile);
+
+		/// <summary>Creates a HedgedCommand</summary>
+		/// <param name="factory">
+		/// Called once per attempt, upon creation. This object takes ownership of the returned commands, so they must not already
+		/// have an owner.
+		/// </param>
+		/// <param name="maxAttempts">
+		/// The most attempts to run per execution, including the first. Each backup waits the hedging delay after the previous
+		/// attempt started. Must be greater than zero.
+		/// </param>
+		/// <param name="initialDelay">
+		/// The time to wait before hedging, until enough latencies have been observed to choose the delay
+		/// </param>
+		/// <param name="percentile">
+		/// The percentile of the observed latencies after which to hedge (e.g. 95 or 99). Must be greater than 0 and no greater
+		/// than 100.
+		/// </param>
+		template<typename Rep, typename Period>
+		static Ptr Create(
+			const CommandFactory& factory, size_t maxAttempts, const std::chrono::duration<Rep, Period>& initialDelay, double percentile)
+		{
+			return Create(factory, maxAttempts, std::chrono::duration_cast<std::chrono::milliseconds>(initialDelay).count(), percentile);
+		}
+
+		/// <summary>The current delay before hedging</summary>
+		/// <returns>
+		/// The number of milliseconds that the next execution will wait before starting a backup attempt
+		/// </returns>
+		long long HedgeDelayMS() const;
+
+		/// <summary>
+		/// Returns diagnostic information about this object's state
+		/// </summary>
+		/// <returns>
+		/// The returned text includes the number of attempts and the current delay before hedging
+		/// </returns>
+		virtual std::string ExtendedDescription() const override;
+
+		/// <inheritdoc/>
+		virtual std::string ClassName() const override;
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		HedgedCommand(const std::vector<Command::Ptr>& attempts, long long initialDelayMS, double percentile);
+	private:
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+		virtual void AbortImpl() override final;
+
+		class Listener : public CommandListener
+		{
+		public:
+			Listener(HedgedCommand* command, size_t index);
+
+			virtual void CommandSucceeded() override final;
+			virtual void CommandAborted() override final;
+			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+		private:
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+			HedgedCommand* const m_command;
+			const size_t m_index;
+		};
+
+		enum class Outcome { Succeeded, Aborted, Failed };
+
+		void ScheduleHedge();
+		void OnTimer(unsigned long long generation);
+		void Hedge(unsigned long long generation);
+		void Launch(size_t index);
+		void OnAttemptFinished(size_t index, Outcome outcome, std::exception_ptr excPtr);
+		void Finish();
+
+		std::vector<Command::Ptr> m_attempts;
+		std::vector<std::unique_ptr<Listener>> m_attemptListeners;
+		std::chrono::steady_clock::time_point m_startTime;
+		const long long m_initialDelayMS;
+		const double m_percentile;
+		LatencyHistogram m_latencies;
+		CommandListener* m_listener = nullptr;
+		size_t m_launched = 0;
+		size_t m_running = 0;
+		bool m_won = false;
+		std::exception_ptr m_error;
+		TimerService::TimerId m_timerId = 0;
+		unsigned long long m_generation = 0;
+		std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// Tracks the distribution of recently observed latencies, so that percentiles of it may be queried
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Samples are counted in buckets whose widths grow with the latency (four buckets per power of two), so any latency can be
+	/// recorded in a small, fixed amount of space, and a reported percentile is never more than 25% above the true value.
+	/// </para>
+	/// <para>
+	/// Each time the given number of samples has been recorded, all counts are halved, so that the influence of older samples
+	/// fades and the histogram follows changes in behavior. This object is thread safe.
+	/// </para>
+	/// </remarks>
+	class LatencyHistogram
+	{
+	public:
+		/// <summary>Constructor</summary>
+		/// <param name="decayInterval">
+		/// The number of samples after which all counts are halved. Must be greater than zero.
+		/// </param>
+		explicit LatencyHistogram(uint64_t decayInterval);
+
+		/// <summary>Records a latency</summary>
+		/// <param name="microseconds">The latency, in microseconds. Negative values are treated as zero.</param>
+		void Record(long long microseconds);
+
+		/// <summary>Records a latency</summary>
+		/// <param name="latency">The latency</param>
+		template<typename Rep, typename Period>
+		void Record(const std::chrono::duration<Rep, Period>& latency)
+		{
+			Record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+		}
+
+		/// <summary>The weight of the samples currently held</summary>
+		/// <returns>The number of samples recorded, less those that have decayed away</returns>
+		uint64_t Count() const;
+
+		/// <summary>Returns the given percentile of the recorded latencies</summary>
+		/// <param name="percentile">The percentile, greater than 0 and no greater than 100 (e.g. 95 or 99.9)</param>
+		/// <returns>
+		/// The upper bound, in microseconds, of the bucket holding the given percentile, or zero if nothing has been recorded
+		/// </returns>
+		long long Percentile(double percentile) const;
+	private:
+		static const size_t SubBucketCount = 4;
+		static const size_t BucketCount = 64 * SubBucketCount;
+
+		static size_t BucketIndex(uint64_t microseconds);
+		static uint64_t BucketUpperBound(size_t index);
+
+		const uint64_t m_decayInterval;
+		uint64_t m_sinceDecay;
+		std::array<uint64_t, BucketCount> m_counts;
+		mutable std::mutex m_mutex;
+	};
+}
@@ -25,6 +25,48 @@ namespace CommandLib
 		/// </param>
 		static Ptr Create(bool abortUponFailure);
 
+		/// <summary>
+		/// Creates a ParallelCommands object as a top-level <see cref="Command"/>, which runs no more than the given number of
+		/// commands at a time
+		/// </summary>
+		/// <param name="abortUponFailure">
+		/// If true, and any <see cref="Command"/> within the collection fails, the rest of the executing commands will immediately be
+		/// aborted, and those not yet started will not be started
+		/// </param>
+		/// <param name="maxConcurrency">
+		/// The most commands that may execute at once. The commands are started in the order they were added, and each time one
+		/// finishes, the next is started. Zero means there is no limit.
+		/// </param>
+		static Ptr Create(bool abortUponFailure, size_t maxConcurrency);
+
+		/// <summary>
+		/// Creates a ParallelCommands object as a top-level <see cref="Command"/>, which races its commands against each other
+		/// </summary>
+		/// <param name="requiredSuccesses">
+		/// As soon as this many commands have succeeded, the rest are aborted, and this object succeeds once they have finished.
+		/// Pass 1 to take the first success, or more for quorum semantics. Must be greater than zero.
+		/// </param>
+		/// <remarks>
+		/// A failing command does not abort the others, unless so many have failed that the required number of successes can no
+		/// longer be reached. In that case the rest are aborted, and this object fails with the first failure reason. If it is
+		/// aborted before enough commands succeed, this object is aborted (or fails, if any command had already failed).
+		/// <para>
+		/// Executing this object throws std::logic_error if it contains fewer commands than <paramref name="requiredSuccesses"/>.
+		/// </para>
+		/// </remarks>
+		static Ptr CreateRace(size_t requiredSuccesses);
+
+		/// <summary>
+		/// Creates a ParallelCommands object as a top-level <see cref="Command"/>, which races its commands against each other, and
+		/// runs no more than the given number of them at a time
+		/// </summary>
+		/// <param name="requiredSuccesses">See <see cref="CreateRace(size_t)"/></param>
+		/// <param name="maxConcurrency">
+		/// The most commands that may execute at once. The commands are started in the order they were added, and each time one
+		/// finishes, the next is started (unless enough have already succeeded). Zero means there is no limit.
+		/// </param>
+		static Ptr CreateRace(size_t requiredSuccesses, size_t maxConcurrency);
+
 		virtual ~ParallelCommands();
 
 		/// <summary>Adds a <see cref="Command"/> to the collection to execute.</summary>
@@ -49,7 +91,7 @@ namespace CommandLib
 		/// <summary>
 		/// This constructor is not public so as to enforce creation using the Create() methods.
 		/// </summary>
-		explicit ParallelCommands(bool abortUponFailure);
+		ParallelCommands(bool abortUponFailure, size_t maxConcurrency, size_t requiredSuccesses);
 	private:
 		virtual void AsyncExecuteImpl(CommandListener* listener) override;
 
@@ -65,17 +107,32 @@ namespace CommandLib
 			Listener(const Listener&) = delete;
 			Listener& operator=(const Listener&) = delete;
 			void OnCommandFinished();
+			void RecordFailure(std::exception_ptr excPtr);
+			void AbortAll();
+			void LaunchNext();
 
             CommandListener* const m_listener;
             ParallelCommands* const m_command;
+            std::atomic_uint m_successCount;
             std::atomic_uint m_failCount;
 			std::atomic_uint m_abortCount;
             std::atomic_uint m_remaining;
+			std::atomic_size_t m_nextLaunch;
+			std::atomic_bool m_abortedChildren;
             std::exception_ptr m_error;
 		};
 
+		// Ranges of commands larger than this are split, and half is handed off to the executor to launch
+		static const size_t LaunchGrain = 8;
+
+		size_t InitialLaunchCount() const;
+		void LaunchRange(Listener* eventHandler, size_t begin, size_t end, bool handedOff);
+
         std::vector<Command::Ptr> m_commands;
         const bool m_abortUponFailure;
-		std::unique_ptr<std::thread> m_thread;
+		const size_t m_maxConcurrency;
+
+		// Zero unless racing, in which case this many successes finish the race
+		const size_t m_requiredSuccesses;
 	};
 }
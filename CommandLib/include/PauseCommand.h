@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "SyncCommand.h"
+#include "WaitGroup.h"
 #include <chrono>
 
 namespace CommandLib
@@ -129,5 +130,6 @@ namespace CommandLib
 		std::shared_ptr<Event> m_cutShortEvent = std::shared_ptr<Event>(new Event());
 		long long m_milliseconds;
 		mutable std::mutex m_durationMutex;
+		WaitGroup m_waitGroup;
 	};
 }
@@ -1,7 +1,8 @@
 ﻿#pragma once
-#include "SyncCommand.h"
-#include "PauseCommand.h"
+#include "AsyncCommand.h"
+#include "AsyncPauseCommand.h"
 #include <atomic>
+#include <mutex>
 
 namespace CommandLib
 {
@@ -9,8 +10,12 @@ namespace CommandLib
 	/// <remarks>
 	/// If more dynamic control is needed around the period of time between executions, use <see cref="RecurringCommand"/> instead.
 	/// </para>
+	/// <para>
+	/// No thread is consumed between executions. The intervals are timed by <see cref="AsyncPauseCommand"/> objects, and each
+	/// repetition is launched asynchronously.
+	/// </para>
 	/// </remarks>
-	class PeriodicCommand : public SyncCommand
+	class PeriodicCommand : public AsyncCommand
     {
 	public:
 		/// <summary>
@@ -240,12 +245,40 @@ namespace CommandLib
 			bool intervalIsInclusive,
 			Waitable::Ptr stopEvent);
 	private:
-		virtual void SyncExeImpl() override final;
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+
+		class Listener : public CommandListener
+		{
+		public:
+			Listener(PeriodicCommand* command, bool isInitialPause);
+
+			virtual void CommandSucceeded() override final;
+			virtual void CommandAborted() override final;
+			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+		private:
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+			PeriodicCommand* const m_command;
+			const bool m_isInitialPause;
+		};
+
+		bool LaunchNextRepetition(bool* aborted);
+		void RestoreInterval();
+		void Continue();
+		void OnRepetitionFinished(bool isInitialPause, std::exception_ptr exc);
+		void Finish(std::exception_ptr exc);
         
-		PauseCommand::Ptr m_pause;
-		PauseCommand::Ptr m_initialPause;
+		AsyncPauseCommand::Ptr m_pause;
+		AsyncPauseCommand::Ptr m_initialPause;
         Command::Ptr m_collectionCmd;
         bool m_startWithPause;
 		Waitable::Ptr m_stopEvent;
+		Listener m_initialPauseListener;
+		Listener m_repetitionListener;
+		CommandListener* m_listener = nullptr;
+		size_t m_repetition = 0;
+		bool m_intervalOverridden = false;
+		long long m_overriddenInterval = 0;
+		std::mutex m_mutex;
 	};
 }
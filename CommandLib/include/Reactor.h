@@ -0,0 +1,84 @@
+#pragma once
+#ifdef __linux__
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// Invokes callbacks when file descriptors become ready. All descriptors are watched by a single epoll thread, so that any
+	/// number of them can be waited upon without tying up a thread apiece.
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Watches are edge triggered: a callback is invoked each time the descriptor becomes ready, not for as long as it stays
+	/// ready.
+	/// </para>
+	/// <para>
+	/// Callbacks are invoked upon the reactor thread, so they must be quick and must not throw. Anything substantial should be
+	/// handed off to an <see cref="Executor"/>.
+	/// </para>
+	/// </remarks>
+	class Reactor
+	{
+	public:
+		/// <summary>Shared pointer to a Reactor object</summary>
+		typedef std::shared_ptr<Reactor> Ptr;
+
+		/// <summary>Identifies a watch. Zero never identifies a watch.</summary>
+		typedef unsigned long long WatchId;
+
+		/// <summary>Creates a Reactor object, which starts its own epoll thread</summary>
+		static Ptr Create();
+
+		/// <summary>The reactor used by the waitables in this library</summary>
+		/// <returns>The default reactor, created upon first use</returns>
+		static Ptr Default();
+
+		/// <summary>Stops the reactor thread</summary>
+		/// <remarks>Do not destroy a Reactor from within one of its own callbacks.</remarks>
+		virtual ~Reactor();
+
+		/// <summary>Starts watching a file descriptor</summary>
+		/// <param name="fd">The file descriptor to watch. It must stay open until <see cref="Unwatch"/> returns.</param>
+		/// <param name="events">The epoll events of interest, such as EPOLLIN or EPOLLOUT</param>
+		/// <param name="callback">The callback to invoke each time the descriptor becomes ready</param>
+		/// <returns>The identifier to pass to <see cref="Unwatch"/></returns>
+		/// <exception cref="std::system_error">The descriptor could not be added to the epoll set</exception>
+		WatchId Watch(int fd, unsigned int events, std::function<void()> callback);
+
+		/// <summary>Stops watching a file descriptor</summary>
+		/// <param name="id">The identifier returned from <see cref="Watch"/></param>
+		/// <returns>true if the watch was removed, false if there was no such watch</returns>
+		/// <remarks>A callback that was already in progress may still be running when this returns.</remarks>
+		bool Unwatch(WatchId id);
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		Reactor();
+	private:
+		struct Watched
+		{
+			int fd;
+			std::shared_ptr<const std::function<void()>> callback;
+		};
+
+		Reactor(const Reactor&) = delete;
+		Reactor& operator=(const Reactor&) = delete;
+
+		void ReactorRoutine();
+
+		std::unordered_map<WatchId, Watched> m_watches;
+		WatchId m_lastId;
+		bool m_stopping;
+		int m_epollFd;
+		int m_wakeFd;
+		std::mutex m_mutex;
+		std::thread m_thread;
+	};
+}
+#endif
@@ -1,14 +1,16 @@
 ﻿#pragma once
-#include "SyncCommand.h"
+#include "AsyncCommand.h"
 #include "ScheduledCommand.h"
+#include <mutex>
 
 namespace CommandLib
 {
 	/// <summary>Represents a <see cref="Command"/> that repeatedly executes at times specified by the caller</summary>
 	/// <remarks>
 	/// If the interval between execution times is fixed, it would be simpler to use <see cref="PeriodicCommand"/> instead.
+	/// No thread is consumed while waiting for the next execution time.
 	/// </remarks>
-	class RecurringCommand : public SyncCommand
+	class RecurringCommand : public AsyncCommand
     {
 	public:
 		/// <summary>
@@ -87,9 +89,30 @@ namespace CommandLib
 		/// </summary>
 		RecurringCommand(Command::Ptr command, ExecutionTimeCallback* callback);
 	private:
-		virtual void SyncExeImpl() override final;
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+
+		class Listener : public CommandListener
+		{
+		public:
+			explicit Listener(RecurringCommand* command);
+
+			virtual void CommandSucceeded() override final;
+			virtual void CommandAborted() override final;
+			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+		private:
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+			RecurringCommand* const m_command;
+		};
+
+		void OnExecutionFinished(std::exception_ptr exc);
+		void Launch(const std::chrono::time_point<std::chrono::system_clock>& executionTime);
+		void Finish(std::exception_ptr exc);
 
         std::shared_ptr<ScheduledCommand> m_scheduledCmd;
         ExecutionTimeCallback* const m_callback;
+		Listener m_scheduledListener;
+		CommandListener* m_listener = nullptr;
+		std::mutex m_mutex;
 	};
 }
@@ -1,13 +1,21 @@
 ﻿#pragma once
-#include "SyncCommand.h"
-#include "PauseCommand.h"
+#include "AsyncCommand.h"
+#include "TimerService.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
 
 namespace CommandLib
 {
 	/// <summary>
 	/// This <see cref="Command"/> wraps another command, allowing the command to be retried upon failure, up to any number of times.
 	/// </summary>
-	class RetryableCommand : public SyncCommand
+	/// <remarks>
+	/// No thread is consumed while waiting between attempts; the wait is tracked by <see cref="TimerService::Default"/>, and
+	/// the next attempt is launched upon the command's <see cref="Executor"/>.
+	/// </remarks>
+	class RetryableCommand : public AsyncCommand
     {
 	public:
 		/// <summary>
@@ -30,6 +38,51 @@ namespace CommandLib
 			virtual bool OnCommandFailed(size_t failNumber, const std::exception& reason, long long* waitMS) = 0;
 		};
 
+		/// <summary>
+		/// A <see cref="RetryCallback"/> that retries a fixed number of times, waiting an exponentially growing, randomized
+		/// interval between attempts ("decorrelated jitter"). Each wait is chosen uniformly between the base wait and three
+		/// times the previous wait, and is never more than the cap.
+		/// </summary>
+		/// <remarks>
+		/// The randomization keeps many commands that failed at the same moment from retrying in lockstep. This object
+		/// tracks the previous wait time, so it should not be shared among commands that execute concurrently.
+		/// </remarks>
+		class ExponentialBackoff : public RetryCallback
+		{
+		public:
+			/// <summary>Constructor</summary>
+			/// <param name="maxRetries">The maximum number of retries. The command executes at most this many times plus one.</param>
+			/// <param name="baseMS">The wait time before the first retry, and the minimum wait time before any retry</param>
+			/// <param name="capMS">The maximum wait time before any retry. Must be no less than baseMS.</param>
+			ExponentialBackoff(size_t maxRetries, long long baseMS, long long capMS);
+
+			/// <summary>Constructor</summary>
+			/// <param name="maxRetries">The maximum number of retries. The command executes at most this many times plus one.</param>
+			/// <param name="base">The wait time before the first retry, and the minimum wait time before any retry</param>
+			/// <param name="cap">The maximum wait time before any retry. Must be no less than base.</param>
+			template<typename Rep1, typename Period1, typename Rep2, typename Period2>
+			ExponentialBackoff(size_t maxRetries, const std::chrono::duration<Rep1, Period1>& base, const std::chrono::duration<Rep2, Period2>& cap)
+				: ExponentialBackoff(
+					maxRetries,
+					std::chrono::duration_cast<std::chrono::milliseconds>(base).count(),
+					std::chrono::duration_cast<std::chrono::milliseconds>(cap).count())
+			{
+			}
+
+			/// <inheritdoc/>
+			virtual bool OnCommandFailed(size_t failNumber, const std::exception& reason, long long* waitMS) override;
+		private:
+			ExponentialBackoff(const ExponentialBackoff&) = delete;
+			ExponentialBackoff& operator=(const ExponentialBackoff&) = delete;
+
+			const size_t m_maxRetries;
+			const long long m_baseMS;
+			const long long m_capMS;
+			long long m_lastWaitMS;
+			std::mt19937_64 m_random;
+			std::mutex m_mutex;
+		};
+
 		/// <summary>Shared pointer to a non-modifyable RetryableCommand object</summary>
 		typedef std::shared_ptr<const RetryableCommand> ConstPtr;
 
@@ -46,6 +99,38 @@ namespace CommandLib
 		/// <param name="callback">This object defines aspects of retry behavior</param>
 		static Ptr Create(Command::Ptr command, RetryCallback* callback);
 
+		/// <summary>
+		/// Creates a RetryableCommand that uses its own <see cref="ExponentialBackoff"/> to define retry behavior
+		/// </summary>
+		/// <param name="command">
+		/// The command to run. This object takes ownership of the command, so the passed command must not already have
+		/// an owner. The passed command will be disposed when this RetryableCommand object is disposed.
+		/// </param>
+		/// <param name="maxRetries">The maximum number of retries</param>
+		/// <param name="baseMS">The wait time before the first retry, and the minimum wait time before any retry</param>
+		/// <param name="capMS">The maximum wait time before any retry. Must be no less than baseMS.</param>
+		static Ptr Create(Command::Ptr command, size_t maxRetries, long long baseMS, long long capMS);
+
+		/// <summary>
+		/// Creates a RetryableCommand that uses its own <see cref="ExponentialBackoff"/> to define retry behavior
+		/// </summary>
+		/// <param name="command">
+		/// The command to run. This object takes ownership of the command, so the passed command must not already have
+		/// an owner. The passed command will be disposed when this RetryableCommand object is disposed.
+		/// </param>
+		/// <param name="maxRetries">The maximum number of retries</param>
+		/// <param name="base">The wait time before the first retry, and the minimum wait time before any retry</param>
+		/// <param name="cap">The maximum wait time before any retry. Must be no less than base.</param>
+		template<typename Rep1, typename Period1, typename Rep2, typename Period2>
+		static Ptr Create(Command::Ptr command, size_t maxRetries, const std::chrono::duration<Rep1, Period1>& base, const std::chrono::duration<Rep2, Period2>& cap)
+		{
+			return Create(
+				command,
+				maxRetries,
+				std::chrono::duration_cast<std::chrono::milliseconds>(base).count(),
+				std::chrono::duration_cast<std::chrono::milliseconds>(cap).count());
+		}
+
 		/// <inheritdoc/>
 		virtual std::string ClassName() const override;
 	protected:
@@ -54,10 +139,36 @@ namespace CommandLib
 		/// </summary>
 		RetryableCommand(Command::Ptr command, RetryCallback* callback);
 	private:
-		virtual void SyncExeImpl() override final;
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
+		virtual void AbortImpl() override final;
+
+        class Listener : public CommandListener
+        {
+		public:
+			explicit Listener(RetryableCommand* command);
+
+			virtual void CommandSucceeded() override final;
+			virtual void CommandAborted() override final;
+			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+		private:
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+            RetryableCommand* const m_command;
+		};
+
+		void Launch();
+		void OnTimer(unsigned long long generation);
+		void OnCommandFailed(const std::exception& exc, std::exception_ptr excPtr);
+		void Finish(std::exception_ptr exc);
 
         Command::Ptr m_command;
-        std::shared_ptr<PauseCommand> m_pauseCmd;
         RetryCallback* const m_callback;
+		std::unique_ptr<RetryCallback> m_ownedCallback;
+		Listener m_childListener;
+		CommandListener* m_listener = nullptr;
+		size_t m_failCount = 0;
+		TimerService::TimerId m_timerId = 0;
+		unsigned long long m_generation = 0;
+		std::mutex m_mutex;
 	};
 }
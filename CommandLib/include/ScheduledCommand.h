@@ -1,14 +1,15 @@
 ﻿#pragma once
-#include "SyncCommand.h"
-#include "PauseCommand.h"
+#include "AsyncCommand.h"
+#include "AsyncPauseCommand.h"
+#include <mutex>
 
 namespace CommandLib
 {
 	/// <summary>
 	/// Represents a <see cref="Command"/> that executes at a given time. When a ScheduledCommand is executed, it will enter an
-	/// efficient wait state until the time arrives at which to execute the underlying command.
+	/// efficient wait state until the time arrives at which to execute the underlying command. No thread is consumed while waiting.
 	/// </summary>
-	class ScheduledCommand : public SyncCommand
+	class ScheduledCommand : public AsyncCommand
     {
 	public:
 		/// <summary>Shared pointer to a non-modifyable ScheduledCommand object</summary>
@@ -76,12 +77,33 @@ namespace CommandLib
 			const std::chrono::time_point<std::chrono::system_clock>& timeOfExecution,
 			bool runImmediatelyIfTimeIsPast);
 	private:
-		virtual void SyncExeImpl() override final;
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
 
-		PauseCommand::Ptr m_pauseCmd;
+		class Listener : public CommandListener
+		{
+		public:
+			Listener(ScheduledCommand* command, bool isPause);
+
+			virtual void CommandSucceeded() override final;
+			virtual void CommandAborted() override final;
+			virtual void CommandFailed(const std::exception& exc, std::exception_ptr excPtr) override final;
+		private:
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+			ScheduledCommand* const m_command;
+			const bool m_isPause;
+		};
+
+		void OnPauseSucceeded();
+		void Finish(std::exception_ptr exc);
+
+		AsyncPauseCommand::Ptr m_pauseCmd;
         Command::Ptr m_command;
         const bool m_runImmediatelyIfTimeIsPast;
 		std::chrono::time_point<std::chrono::system_clock> m_timeOfExecution;
+		Listener m_pauseListener;
+		Listener m_commandListener;
+		CommandListener* m_listener = nullptr;
 		mutable std::mutex m_mutex;
 	};
 }
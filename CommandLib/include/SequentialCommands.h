@@ -1,6 +1,5 @@
 ﻿#pragma once
 #include "SyncCommand.h"
-#include <thread>
 
 namespace CommandLib
 {
@@ -58,23 +57,28 @@ namespace CommandLib
 		class Listener : public CommandListener
 		{
 		public:
+			explicit Listener(SequentialCommands* command);
 			void CommandSucceeded() override;
 			void CommandAborted() override;
 			void CommandFailed(const std::exception& exc, std::exception_ptr excPtr);
-			void SetExternalListener(CommandListener* listener);
-			void SetCommands(std::list<Command::Ptr>::iterator iter, std::list<Command::Ptr>::iterator end);
+			void Start(CommandListener* listener, size_t index);
 		private:
-			std::list<Command::Ptr>::iterator m_iter;
-			std::list<Command::Ptr>::iterator m_end;
+			void Run(bool onExecutor);
+
+			SequentialCommands* const m_command;
+			size_t m_index = 0;
 			CommandListener* volatile m_externalListener = nullptr;
 		};
 
 		virtual void SyncExecuteImpl() final;
 		virtual void AsyncExecuteImpl(CommandListener* listener) final;
-		void DoAsyncExecute(CommandListener* listener, std::list<Command::Ptr>::iterator iter, std::list<Command::Ptr>::iterator end);
+		void CacheTraits();
+
+        std::vector<Command::Ptr> m_commands;
 
-        std::list<Command::Ptr> m_commands;
+		// Whether each command is naturally synchronous, sampled once per execution, so that stepping through the commands
+		// makes no virtual calls (which, for nested collections, examine the whole subtree)
+		std::vector<bool> m_synchronous;
 		Listener m_listener;
-		std::unique_ptr<std::thread> m_thread;
 	};
 }
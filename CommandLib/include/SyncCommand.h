@@ -1,6 +1,5 @@
 ﻿#pragma once
 #include "Command.h"
-#include <thread>
 
 namespace CommandLib
 {
@@ -8,6 +7,10 @@ namespace CommandLib
 	/// Represents a <see cref="Command"/> which is most naturally synchronous in its implementation. If you inherit from this class,
 	/// you are responsible for implementing <see cref="Command::SyncExeImpl"/>. This class implements <see cref="Command::AsyncExecuteImpl"/>.
 	/// </summary>
+	/// <remarks>
+	/// Asynchronous execution runs <see cref="SyncExeImpl"/> upon the command's <see cref="Executor"/> (see <see cref="Command::GetExecutor"/>),
+	/// rather than upon a newly created thread.
+	/// </remarks>
 	class SyncCommand : public Command
     {
 	public:
@@ -39,7 +42,5 @@ namespace CommandLib
 
 		virtual void AsyncExecuteImpl(CommandListener* listener) final;
 		virtual void SyncExecuteImpl() final;
-
-		std::unique_ptr<std::thread> m_thread;
 	};
 }
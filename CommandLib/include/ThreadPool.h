@@ -0,0 +1,137 @@
+#pragma once
+#include "Executor.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// An <see cref="Executor"/> that runs work upon a pool of worker threads. Unless a different <see cref="Executor"/> is
+	/// attached to a command tree, <see cref="Default"/> is used for all asynchronous work.
+	/// </summary>
+	/// <remarks>
+	/// <para>
+	/// Each worker has its own queue. Work posted from a worker goes upon that worker's queue, and the worker runs its newest
+	/// work first, which keeps the data of a freshly launched child command warm in its cache. Idle workers steal the oldest
+	/// work from the other queues, so that the work of a wide or deeply nested command tree spreads across the pool without
+	/// every post contending upon one central queue.
+	/// </para>
+	/// <para>
+	/// The pool keeps a fixed number of worker threads alive for its lifetime. Because synchronous command implementations block
+	/// the thread they run upon (sometimes for a very long time), a strictly fixed number of threads could deadlock when every
+	/// worker is waiting upon work that is still sitting in a queue. To prevent that, if queued work has been left waiting for a
+	/// short while with no worker idle, additional workers are started. Such a worker exits after it has been idle for a short
+	/// while, so the number of threads settles back down to the configured count.
+	/// </para>
+	/// <para>
+	/// Upon destruction, the pool runs any work that is still queued and then waits for all worker threads to exit.
+	/// </para>
+	/// </remarks>
+	class ThreadPool : public Executor
+	{
+	public:
+		/// <summary>Shared pointer to a ThreadPool object</summary>
+		typedef std::shared_ptr<ThreadPool> Ptr;
+
+		/// <summary>Creates a ThreadPool object</summary>
+		/// <param name="threadCount">The number of worker threads to keep alive. Must be greater than zero.</param>
+		static Ptr Create(size_t threadCount);
+
+		/// <summary>The pool used when no other has been specified</summary>
+		/// <returns>
+		/// The default pool. It is created upon first use with the number of threads set via <see cref="SetDefaultThreadCount"/>,
+		/// or the number of hardware threads if that was never called.
+		/// </returns>
+		static Ptr Default();
+
+		/// <summary>Sets the number of worker threads the default pool will keep alive</summary>
+		/// <param name="threadCount">The number of worker threads. Must be greater than zero.</param>
+		/// <remarks>
+		/// This must be called before the default pool is first used (that is, before any <see cref="Command"/> is executed
+		/// asynchronously). Otherwise, a std::logic_error is thrown.
+		/// </remarks>
+		static void SetDefaultThreadCount(size_t threadCount);
+
+		virtual ~ThreadPool();
+
+		/// <summary>Queues work to be run upon one of the worker threads</summary>
+		/// <param name="task">The work to run. It must not throw.</param>
+		virtual void Execute(std::function<void()> task) override;
+
+		/// <inheritdoc/>
+		virtual bool IsWorkerThread() const override;
+
+		/// <summary>The number of worker threads this pool keeps alive</summary>
+		/// <returns>The number of worker threads passed upon creation</returns>
+		size_t ThreadCount() const;
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		explicit ThreadPool(size_t threadCount);
+	private:
+		// Worker threads keep the shared state alive, so that a pool may safely be destroyed from one of its own workers
+		// (for example, when the last reference to it is held by a command that finishes upon that worker).
+		class State
+		{
+		public:
+			explicit State(size_t threadCount);
+			void StartPermanentWorkers(const std::shared_ptr<State>& state);
+			void Post(std::function<void()> task, const std::shared_ptr<State>& state);
+			void Shutdown();
+			bool IsWorkerThread() const;
+		private:
+			struct WorkQueue
+			{
+				std::deque<std::function<void()>> tasks;
+				std::mutex mutex;
+			};
+
+			static void WorkerRoutine(std::shared_ptr<State> state, WorkQueue* queue);
+			void StartWorker(const std::shared_ptr<State>& state, WorkQueue* queue);
+			bool TryTake(WorkQueue* own, std::function<void()>& task);
+			bool TakeNewest(WorkQueue& queue, std::function<void()>& task);
+			bool TakeOldest(WorkQueue& queue, std::function<void()>& task);
+			void ScheduleStarvationCheck(const std::shared_ptr<State>& state);
+			void CheckStarvation(const std::shared_ptr<State>& state);
+			void JoinRetiredWorkers();
+
+			// The pool and queue of the worker running upon the current thread, if any
+			static thread_local const State* tl_state;
+			static thread_local WorkQueue* tl_queue;
+			static thread_local size_t tl_nextVictim;
+
+			// One per permanent worker. Each worker takes its own newest work first, and steals the oldest work of others
+			// when it runs out. Fixed upon construction, so it can be scanned without locking.
+			std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+			// Work posted from threads that have no queue of their own in this pool
+			WorkQueue m_injected;
+
+			// Counts posted work that has not yet been taken. Incremented before the work is queued, so that a worker
+			// never concludes there is nothing left to do while a post is in progress.
+			std::atomic_size_t m_queuedCount;
+			std::atomic_size_t m_idleCount;
+			std::atomic_bool m_stopping;
+			std::atomic_bool m_starvationCheckPending;
+			size_t m_starvationGrowth;
+			std::unordered_map<std::thread::id, std::thread> m_workers;
+			std::vector<std::thread::id> m_retired;
+			std::condition_variable m_condition;
+			std::mutex m_mutex;
+		};
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		const size_t m_threadCount;
+		std::shared_ptr<State> m_state;
+	};
+}
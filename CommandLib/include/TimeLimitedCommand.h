@@ -1,5 +1,7 @@
 ﻿#pragma once
-#include "SyncCommand.h"
+#include "AsyncCommand.h"
+#include "TimerService.h"
+#include <mutex>
 
 namespace CommandLib
 {
@@ -9,8 +11,10 @@ namespace CommandLib
 	/// </summary>
 	/// <remarks>
 	/// The underlying command to execute must be responsive to abort requests in order for the timeout interval to be honored.
+	/// No thread is consumed while waiting; the deadline is tracked by <see cref="TimerService::Default"/>, and the underlying
+	/// command is aborted via the command's <see cref="Executor"/> when it expires.
 	/// </remarks>
-	class TimeLimitedCommand : public SyncCommand
+	class TimeLimitedCommand : public AsyncCommand
     {
 	public:
 		/// <summary>Shared pointer to a non-modifyable TimeLimitedCommand object</summary>
@@ -63,7 +67,7 @@ namespace CommandLib
 		/// </summary>
 		explicit TimeLimitedCommand(long long timeoutMS, Command::Ptr commandToRun);
 	private:
-		virtual void SyncExeImpl() override final;
+		virtual void AsyncExecuteImpl(CommandListener* listener) override final;
 
         class Listener : public CommandListener
         {
@@ -79,8 +83,20 @@ namespace CommandLib
             TimeLimitedCommand* const m_command;
 		};
 
+		void OnTimeout(unsigned long long generation);
+		void OnChildFinished(std::exception_ptr exc);
+		void Finish();
+
 		Command::Ptr m_commandToRun;
 		const long long m_timeoutMS;
+		Listener m_childListener;
+		CommandListener* m_listener = nullptr;
+		TimerService::TimerId m_timerId = 0;
+		unsigned long long m_generation = 0;
+		bool m_timedOut = false;
+		bool m_abortInProgress = false;
+		bool m_childFinished = false;
         std::exception_ptr m_lastException;
+		std::mutex m_mutex;
 	};
 }
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// Invokes callbacks when deadlines arrive. All deadlines are tracked by a single thread, so that any number of pending
+	/// delays can exist without tying up a thread apiece.
+	/// </summary>
+	/// <remarks>
+	/// Callbacks are invoked upon the timer thread, so they must be quick and must not throw. Anything substantial (such as
+	/// informing a <see cref="CommandListener"/>) should be handed off to an <see cref="Executor"/>.
+	/// </remarks>
+	class TimerService
+	{
+	public:
+		/// <summary>Shared pointer to a TimerService object</summary>
+		typedef std::shared_ptr<TimerService> Ptr;
+
+		/// <summary>Identifies a scheduled callback. Zero never identifies a callback.</summary>
+		typedef unsigned long long TimerId;
+
+		/// <summary>Creates a TimerService object, which starts its own timer thread</summary>
+		static Ptr Create();
+
+		/// <summary>The timer service used by the commands in this library</summary>
+		/// <returns>The default timer service, created upon first use</returns>
+		static Ptr Default();
+
+		/// <summary>Stops the timer thread. Callbacks that have not yet been invoked are discarded.</summary>
+		/// <remarks>Do not destroy a TimerService from within one of its own callbacks.</remarks>
+		virtual ~TimerService();
+
+		/// <summary>Schedules a callback to be invoked after the given number of milliseconds</summary>
+		/// <param name="ms">The number of milliseconds to wait. Negative values are treated as zero.</param>
+		/// <param name="callback">The callback to invoke</param>
+		/// <returns>The identifier to pass to <see cref="Cancel"/></returns>
+		TimerId Schedule(long long ms, std::function<void()> callback);
+
+		/// <summary>Schedules a callback to be invoked after the given duration</summary>
+		/// <param name="dur">The amount of time to wait</param>
+		/// <param name="callback">The callback to invoke</param>
+		/// <returns>The identifier to pass to <see cref="Cancel"/></returns>
+		template<typename Rep, typename Period>
+		TimerId Schedule(const std::chrono::duration<Rep, Period>& dur, std::function<void()> callback)
+		{
+			return Schedule(std::chrono::duration_cast<std::chrono::milliseconds>(dur).count(), callback);
+		}
+
+		/// <summary>Prevents a scheduled callback from being invoked</summary>
+		/// <param name="id">The identifier returned from <see cref="Schedule"/></param>
+		/// <returns>true if the callback was cancelled, false if it has already been invoked (or is being invoked)</returns>
+		bool Cancel(TimerId id);
+	protected:
+		/// <summary>
+		/// This constructor is not public so as to enforce creation using the Create() methods.
+		/// </summary>
+		TimerService();
+	private:
+		typedef std::chrono::steady_clock::time_point TimePoint;
+		typedef std::pair<TimePoint, TimerId> Key;
+
+		TimerService(const TimerService&) = delete;
+		TimerService& operator=(const TimerService&) = delete;
+
+		void TimerRoutine();
+
+		// Ordered by deadline, then by id, so that callbacks with the same deadline fire in the order they were scheduled
+		std::map<Key, std::function<void()>> m_timers;
+		std::unordered_map<TimerId, TimePoint> m_deadlines;
+		TimerId m_lastId;
+		bool m_stopping;
+		std::condition_variable m_condition;
+		std::mutex m_mutex;
+		std::thread m_thread;
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <chrono>
+
+namespace CommandLib
+{
+	/// <summary>
+	/// Limits the rate of some activity, while allowing short bursts of it
+	/// </summary>
+	/// <remarks>
+	/// Tokens accumulate at a fixed rate, up to a maximum (the burst size), and each occurrence of the activity takes one. The bucket
+	/// starts out full. This object is not thread safe; its owner is expected to serialize access to it.
+	/// </remarks>
+	class TokenBucket
+	{
+	public:
+		/// <summary>Constructor</summary>
+		/// <param name="ratePerSecond">The number of tokens added per second. Must be greater than zero.</param>
+		/// <param name="burst">The most tokens that can accumulate. Must be at least 1.</param>
+		TokenBucket(double ratePerSecond, double burst);
+
+		/// <summary>Whether a token can be taken</summary>
+		/// <param name="now">The current time</param>
+		/// <returns>true if <see cref="TryTake"/> would succeed at the given time</returns>
+		bool IsAvailable(std::chrono::steady_clock::time_point now);
+
+		/// <summary>Takes a token, if one is available</summary>
+		/// <param name="now">The current time</param>
+		/// <returns>true if a token was taken</returns>
+		bool TryTake(std::chrono::steady_clock::time_point now);
+
+		/// <summary>How long until a token can be taken</summary>
+		/// <param name="now">The current time</param>
+		/// <returns>The number of milliseconds (rounded up) until a token is available, or zero if one already is</returns>
+		long long MillisecondsUntilAvailable(std::chrono::steady_clock::time_point now);
+	private:
+		void Refill(std::chrono::steady_clock::time_point now);
+
+		const double m_ratePerSecond;
+		const double m_burst;
+		double m_tokens;
+		std::chrono::steady_clock::time_point m_lastRefill;
+	};
+}
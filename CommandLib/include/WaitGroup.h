@@ -3,8 +3,8 @@
 #include "Event.h"
 #include <chrono>
 #include <atomic>
-#include <list>
-#include <unordered_set>
+#include <array>
+#include <deque>
 #include <mutex>
 
 namespace CommandLib
@@ -14,7 +14,13 @@ namespace CommandLib
 	/// efficiently wait upon any number of <see cref="Waitable"/> objects, until either one or all of the objects
 	/// enter a signaled state.
 	/// </summary>
-	/// <remarks>Behavior is undefined if you access the same WaitGroup object across multiple threads.</remarks>
+	/// <remarks>
+	/// <para>Behavior is undefined if you access the same WaitGroup object across multiple threads.</para>
+	/// <para>
+	/// A WaitGroup may be waited upon any number of times. Waiting does not allocate, so on hot paths build the group once
+	/// and reuse it.
+	/// </para>
+	/// </remarks>
 	class WaitGroup
     {
 	public:
@@ -108,14 +114,14 @@ namespace CommandLib
 		/// </remarks>
 		bool WaitForAll(long long ms) const;
 	private:
-		class WaitGroupImpl : public std::enable_shared_from_this<WaitGroupImpl>, public WaitMonitor
+		class WaitGroupImpl : public std::enable_shared_from_this<WaitGroupImpl>
 		{
 		public:
 			typedef std::shared_ptr<WaitGroupImpl> Ptr;
 			static Ptr Create();
-
 			virtual ~WaitGroupImpl();
 			void AddWaitable(Waitable::Ptr item);
+			void RemoveAll();
 			int WaitForAny() const;
 
 			template<typename Rep, typename Period>
@@ -150,18 +156,42 @@ namespace CommandLib
 				return true;
 			}
 		private:
+			// One per waitable, registered as that waitable's listener. Knowing its own index makes reporting which item
+			// was signaled O(1).
+			class Entry : public WaitMonitor
+			{
+			public:
+				Entry();
+				virtual void Signaled(const Waitable& item) override final;
+
+				Waitable::Ptr m_waitable;
+				WaitGroupImpl* m_group;
+				int m_index;
+
+				// Equal to the group's wait number if the item has been signaled during the current wait
+				mutable unsigned long long m_signaledWait;
+			};
+
+			// Most groups are small. Entries beyond this count go in m_overflow, which also keeps their addresses stable.
+			static const size_t InlineCapacity = 4;
+
 			WaitGroupImpl();
 			WaitGroupImpl(const WaitGroup&);
 			WaitGroupImpl& operator=(const WaitGroupImpl&);
 
-			virtual void Signaled(const Waitable& item) override final;
+			Entry& At(size_t index) const;
+			WaitMonitor::Ptr Monitor(Entry& entry);
+			void Signaled(int index);
 			int AnySignaled() const;
 			bool AllSignaled() const;
 			void InitializeSignaled() const;
 
-			std::list<Waitable::Ptr> m_list;
-			mutable std::unordered_set<const Waitable*> m_signaled;
-			mutable const Waitable* m_firstSignaled;
+			mutable std::array<Entry, InlineCapacity> m_inline;
+			mutable std::deque<Entry> m_overflow;
+			size_t m_count;
+			mutable unsigned long long m_wait;
+			mutable size_t m_signaledCount;
+			mutable int m_firstSignaled;
 			mutable Event m_waitSignaledEvent;
 			mutable std::mutex m_mutex;
 		};
@@ -0,0 +1,87 @@
+#include "CppUnitTest.h"
+#include "AsyncPauseCommand.h"
+#include "ParallelCommands.h"
+#include "CommonTests.h"
+#include "CmdListener.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(AsyncPauseCommandTests)
+	{
+	public:
+		TEST_METHOD(AsyncPauseCommand_TestAbort)
+		{
+			CommandLib::AsyncPauseCommand::Ptr pauseCmd = CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24));
+			CommonTests::TestAbort(pauseCmd, 10);
+		}
+
+		TEST_METHOD(AsyncPauseCommand_TestHappyPath)
+		{
+			CommonTests::TestHappyPath(CommandLib::AsyncPauseCommand::Create(1));
+			CommonTests::TestHappyPath(CommandLib::AsyncPauseCommand::Create(0));
+			CommandLib::AsyncPauseCommand::Ptr shortPause = CommandLib::AsyncPauseCommand::Create(100);
+			CmdListener listener(CmdListener::CallbackType::Succeeded);
+			shortPause->AsyncExecute(&listener);
+			CommandLib::AsyncPauseCommand::Ptr longPause = CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24), shortPause->DoneEvent());
+			CommonTests::TestHappyPath(longPause);
+		}
+
+		TEST_METHOD(AsyncPauseCommand_TestReset)
+		{
+			CommandLib::AsyncPauseCommand::Ptr pauseCmd = CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24));
+			CmdListener listener(CmdListener::CallbackType::Succeeded);
+			pauseCmd->AsyncExecute(&listener);
+			pauseCmd->SetDurationMS(1);
+			Assert::IsFalse(pauseCmd->Wait(10));
+			pauseCmd->Reset();
+			Assert::IsTrue(pauseCmd->Wait(100));
+			listener.Check();
+
+			listener.Reset(CmdListener::CallbackType::Aborted);
+			pauseCmd->SetDurationMS(50);
+			pauseCmd->AsyncExecute(&listener);
+			pauseCmd->SetDuration(std::chrono::hours(24));
+			pauseCmd->Reset();
+			Assert::IsFalse(pauseCmd->Wait(100));
+			pauseCmd->AbortAndWait();
+			listener.Check();
+		}
+
+		TEST_METHOD(AsyncPauseCommand_TestCutShort)
+		{
+			CommandLib::AsyncPauseCommand::Ptr pauseCmd = CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24));
+			CmdListener listener(CmdListener::CallbackType::Succeeded);
+			pauseCmd->AsyncExecute(&listener);
+			pauseCmd->CutShort();
+			pauseCmd->Wait();
+			listener.Check();
+
+			listener.Reset(CmdListener::CallbackType::Aborted);
+			pauseCmd->CutShort(); // no-op
+			pauseCmd->AsyncExecute(&listener);
+			Assert::IsFalse(pauseCmd->Wait(10));
+			pauseCmd->AbortAndWait();
+			listener.Check();
+		}
+
+		TEST_METHOD(AsyncPauseCommand_TestManyPending)
+		{
+			// Far more pauses than there are pool threads. They must all run concurrently.
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				parallelCmds->Add(CommandLib::AsyncPauseCommand::Create(100));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			parallelCmds->SyncExecute();
+			Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+			parallelCmds->Add(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)));
+			CommonTests::TestAbort(parallelCmds, 10);
+		}
+	};
+}
@@ -3,13 +3,21 @@
 #include "CommonTests.h"
 #include "CmdListener.h"
 #include "PauseCommand.h"
+#include "AsyncPauseCommand.h"
 #include "CppUnitTestAssert.h"
 #include "CommandAbortedException.h"
+#include "BacklogFullException.h"
+#include "CommandTimeoutException.h"
 #include "CmdListener.h"
 #include "TestMonitors.h"
 #include "FailingCommand.h"
 #include "SequentialCommands.h"
 #include "AsyncCommand.h"
+#include "SyncCommand.h"
+#include "AddCommand.h"
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -37,6 +45,76 @@ namespace UnitTest
 		}
 	};
 
+	// Records the order in which instances execute
+	class OrderRecordingCommand : public CommandLib::SyncCommand
+	{
+	public:
+		class Log
+		{
+		public:
+			void Append(int id)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_ids.push_back(id);
+			}
+
+			std::vector<int> Ids()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				return m_ids;
+			}
+		private:
+			std::vector<int> m_ids;
+			std::mutex m_mutex;
+		};
+
+		typedef std::shared_ptr<OrderRecordingCommand> Ptr;
+		static Ptr Create(Log* log, int id) { return Ptr(new OrderRecordingCommand(log, id)); }
+		virtual std::string ClassName() const override { return "OrderRecordingCommand"; }
+	private:
+		OrderRecordingCommand(Log* log, int id) : m_log(log), m_id(id) {}
+		virtual void SyncExeImpl() override final { m_log->Append(m_id); }
+
+		Log* const m_log;
+		const int m_id;
+	};
+
+	// Records its id, and whether another instance sharing the same counter was executing at the same time
+	class SerialCheckCommand : public CommandLib::SyncCommand
+	{
+	public:
+		typedef std::shared_ptr<SerialCheckCommand> Ptr;
+
+		static Ptr Create(OrderRecordingCommand::Log* log, int id, std::atomic_int* executing, std::atomic_bool* overlapped)
+		{
+			return Ptr(new SerialCheckCommand(log, id, executing, overlapped));
+		}
+
+		virtual std::string ClassName() const override { return "SerialCheckCommand"; }
+	private:
+		SerialCheckCommand(OrderRecordingCommand::Log* log, int id, std::atomic_int* executing, std::atomic_bool* overlapped)
+			: m_log(log), m_id(id), m_executing(executing), m_overlapped(overlapped)
+		{
+		}
+
+		virtual void SyncExeImpl() override final
+		{
+			if (++*m_executing > 1)
+			{
+				*m_overlapped = true;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			m_log->Append(m_id);
+			--*m_executing;
+		}
+
+		OrderRecordingCommand::Log* const m_log;
+		const int m_id;
+		std::atomic_int* const m_executing;
+		std::atomic_bool* const m_overlapped;
+	};
+
 	class Monitor : public CommandLib::CommandMonitor
 	{
 	public:
@@ -161,6 +239,473 @@ namespace UnitTest
 			Assert::AreEqual(0U, monitor.m_aborted.operator size_t());
 		}
 
+		TEST_METHOD(CommandDispatcher_TestPriority)
+		{
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(50)); // keeps the rest queued
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 2), 10);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 3), -5);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 4));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 5), 10);
+			}
+
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 2, 5, 1, 4, 3 }));
+		}
+
+		TEST_METHOD(CommandDispatcher_TestPriorityAging)
+		{
+			// Without aging, the urgent command overtakes the one that has waited longer
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(100));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1));
+				std::this_thread::sleep_for(std::chrono::milliseconds(60));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 2), 10);
+			}
+
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 2, 1 }));
+
+			// With aging, it does not
+			OrderRecordingCommand::Log agingLog;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.SetAgingInterval(std::chrono::milliseconds(1));
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(100));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&agingLog, 1));
+				std::this_thread::sleep_for(std::chrono::milliseconds(60));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&agingLog, 2), 10);
+			}
+
+			Assert::IsTrue(agingLog.Ids() == std::vector<int>({ 1, 2 }));
+		}
+
+		TEST_METHOD(CommandDispatcher_TestConcurrentDispatch)
+		{
+			// Many threads dispatch at once, both with room in the pool and with the pool full
+			for (size_t maxConcurrent : { size_t(1000000), size_t(3) })
+			{
+				Monitor monitor;
+				std::atomic_int total;
+				total = 0;
+
+				{
+					CommandLib::CommandDispatcher dispatcher(maxConcurrent);
+					dispatcher.AddMonitor(&monitor);
+					std::vector<std::thread> threads;
+
+					for (int i = 0; i < 4; ++i)
+					{
+						threads.emplace_back([&dispatcher, &total, i]()
+						{
+							for (int j = 0; j < 2000; ++j)
+							{
+								dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 1), j % 3);
+							}
+						});
+					}
+
+					for (std::thread& thread : threads)
+					{
+						thread.join();
+					}
+
+					dispatcher.Wait();
+					Assert::AreEqual(8000, (int)total);
+				}
+
+				Assert::AreEqual(8000U, monitor.m_completed.operator size_t());
+				Assert::AreEqual(0U, monitor.m_failed.operator size_t());
+				Assert::AreEqual(0U, monitor.m_aborted.operator size_t());
+			}
+		}
+
+		TEST_METHOD(CommandDispatcher_TestBacklogLimit)
+		{
+			Monitor monitor;
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.AddMonitor(&monitor);
+				dispatcher.SetBacklogLimit(2, CommandLib::CommandDispatcher::OverflowPolicy::RejectNewest);
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(50)); // keeps the rest queued
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1));
+				Assert::IsTrue(dispatcher.TryDispatch(OrderRecordingCommand::Create(&log, 2)));
+				Assert::IsFalse(dispatcher.TryDispatch(OrderRecordingCommand::Create(&log, 3)));
+				Assert::IsFalse(dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 4), 0, std::chrono::hours(24)));
+				Assert::ExpectException<CommandLib::BacklogFullException>([&dispatcher, &log]()
+				{
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 5));
+				}, L"Dispatched to a full backlog");
+
+				// The oldest queued command makes room for the newest
+				dispatcher.SetBacklogLimit(2, CommandLib::CommandDispatcher::OverflowPolicy::DropOldest);
+				Assert::IsTrue(dispatcher.TryDispatch(OrderRecordingCommand::Create(&log, 6), 10));
+			}
+
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 6, 2 }));
+			Assert::AreEqual(3U, monitor.m_completed.operator size_t());
+			Assert::AreEqual(0U, monitor.m_failed.operator size_t());
+			Assert::AreEqual(1U, monitor.m_aborted.operator size_t());
+
+			// Under the blocking policy, a producer waits for room
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.SetBacklogLimit(1, CommandLib::CommandDispatcher::OverflowPolicy::Block);
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(50));
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(0));
+				Assert::IsFalse(dispatcher.TryDispatch(CommandLib::PauseCommand::Create(0)));
+				Assert::IsFalse(dispatcher.Dispatch(CommandLib::PauseCommand::Create(0), 0, 10));
+
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(0));
+				Assert::IsTrue(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(30));
+			}
+		}
+
+		TEST_METHOD(CommandDispatcher_TestBacklogWatermarks)
+		{
+			CommandLib::CommandDispatcher dispatcher(1);
+			dispatcher.SetBacklogWatermarks(1, 3);
+			Assert::IsFalse(dispatcher.BacklogHighEvent()->IsSignaled());
+			Assert::IsTrue(dispatcher.BacklogLowEvent()->IsSignaled());
+
+			dispatcher.Dispatch(CommandLib::PauseCommand::Create(50));
+
+			for (int i = 0; i < 3; ++i)
+			{
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(0));
+			}
+
+			Assert::IsTrue(dispatcher.BacklogHighEvent()->IsSignaled());
+			Assert::IsFalse(dispatcher.BacklogLowEvent()->IsSignaled());
+
+			Assert::IsTrue(dispatcher.BacklogLowEvent()->Wait(5000));
+			Assert::IsFalse(dispatcher.BacklogHighEvent()->IsSignaled());
+			dispatcher.Wait();
+		}
+
+		TEST_METHOD(CommandDispatcher_TestAdaptiveConcurrency)
+		{
+			CommandLib::CommandDispatcher dispatcher(4);
+			dispatcher.SetAdaptiveConcurrency(2, 32);
+			Assert::AreEqual(size_t(4), dispatcher.ConcurrencyLimit());
+
+			// Commands that take no longer under load let the limit grow
+			for (int i = 0; i < 300; ++i)
+			{
+				dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(5));
+			}
+
+			dispatcher.Wait();
+			const size_t grownLimit = dispatcher.ConcurrencyLimit();
+			Assert::IsTrue(grownLimit > 4 && grownLimit <= 32);
+
+			// Commands that suddenly take much longer make it shrink
+			for (int i = 0; i < 100; ++i)
+			{
+				dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(40));
+			}
+
+			dispatcher.Wait();
+			Assert::IsTrue(dispatcher.ConcurrencyLimit() < grownLimit);
+			Assert::IsTrue(dispatcher.ConcurrencyLimit() >= 2);
+		}
+
+		TEST_METHOD(CommandDispatcher_TestRateLimit)
+		{
+			std::atomic_int total;
+			total = 0;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			{
+				CommandLib::CommandDispatcher dispatcher(100);
+				dispatcher.SetRateLimit(50, 5);
+
+				for (int i = 0; i < 30; ++i)
+				{
+					dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 1));
+				}
+			}
+
+			// After the first burst of 5, one command every 20ms
+			Assert::AreEqual(30, (int)total);
+			Assert::IsTrue(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(450));
+
+			// A tag that is held back does not hold back the others
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(100);
+				dispatcher.SetRateLimit("slow", 10, 1);
+				CommandLib::CommandDispatcher::DispatchOptions slow;
+				slow.tag = "slow";
+
+				for (int i = 1; i <= 3; ++i)
+				{
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, i), slow);
+				}
+
+				for (int i = 4; i <= 13; ++i)
+				{
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, i));
+				}
+			}
+
+			const std::vector<int> ids = log.Ids();
+			Assert::AreEqual(size_t(13), ids.size());
+			Assert::AreEqual(2, ids[11]);
+			Assert::AreEqual(3, ids[12]);
+		}
+
+		TEST_METHOD(CommandDispatcher_TestRateLimitAbort)
+		{
+			Monitor monitor;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(10);
+				dispatcher.AddMonitor(&monitor);
+				dispatcher.SetRateLimit(1, 1);
+
+				for (int i = 0; i < 5; ++i)
+				{
+					dispatcher.Dispatch(CommandLib::PauseCommand::Create(0));
+				}
+
+				// The queued commands, and the timer that would release them, are discarded
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				dispatcher.AbortAndWait();
+				Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+			}
+
+			// Only the first command started, and it may have been aborted
+			Assert::AreEqual(1U, (unsigned)(monitor.m_completed + monitor.m_aborted));
+			Assert::AreEqual(0U, monitor.m_failed.operator size_t());
+		}
+
+		TEST_METHOD(CommandDispatcher_TestFairQueueing)
+		{
+			// A tag with many commands queued does not make the others wait behind all of them
+			for (double weight : { 1.0, 2.0 })
+			{
+				OrderRecordingCommand::Log log;
+
+				{
+					CommandLib::CommandDispatcher dispatcher(1);
+					dispatcher.SetTagWeight("a", weight);
+					dispatcher.Dispatch(CommandLib::PauseCommand::Create(50)); // keeps the rest queued
+					CommandLib::CommandDispatcher::DispatchOptions options;
+					options.tag = "a";
+
+					for (int i = 1; i <= 6; ++i)
+					{
+						dispatcher.Dispatch(OrderRecordingCommand::Create(&log, i), options);
+					}
+
+					options.tag = "b";
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 101), options);
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 102), options);
+					options.tag = "c";
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 201), options);
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 202), options);
+				}
+
+				if (weight == 1)
+				{
+					Assert::IsTrue(log.Ids() == std::vector<int>({ 1, 101, 201, 2, 102, 202, 3, 4, 5, 6 }));
+				}
+				else
+				{
+					Assert::IsTrue(log.Ids() == std::vector<int>({ 1, 2, 101, 201, 3, 4, 102, 202, 5, 6 }));
+				}
+			}
+		}
+
+		TEST_METHOD(CommandDispatcher_TestDeadlines)
+		{
+			Monitor monitor;
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.AddMonitor(&monitor);
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(100)); // keeps the rest queued
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				CommandLib::CommandDispatcher::DispatchOptions options;
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1), options);
+				options.deadline = now + std::chrono::hours(2);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 2), options);
+				options.deadline = now + std::chrono::hours(1);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 3), options);
+
+				// These will have expired by the time there is room
+				options.deadline = now + std::chrono::milliseconds(20);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 4), options);
+				options.priority = 5;
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 5), options);
+
+				// This one has expired already
+				options.deadline = now - std::chrono::milliseconds(1);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 6), options);
+				Assert::AreEqual(1U, monitor.m_failed.operator size_t());
+			}
+
+			// Earliest deadline first, and those without deadlines last
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 3, 2, 1 }));
+			Assert::AreEqual(4U, monitor.m_completed.operator size_t());
+			Assert::AreEqual(3U, monitor.m_failed.operator size_t());
+			Assert::AreEqual(0U, monitor.m_aborted.operator size_t());
+		}
+
+		TEST_METHOD(CommandDispatcher_TestDeadlinesWithAging)
+		{
+			// A stream of commands with deadlines must not starve an older command without one, whether they are of the same
+			// priority or of a higher one
+			for (int priority = 0; priority <= 1; ++priority)
+			{
+				OrderRecordingCommand::Log log;
+
+				{
+					CommandLib::CommandDispatcher dispatcher(1);
+					dispatcher.SetAgingInterval(std::chrono::milliseconds(10));
+					dispatcher.Dispatch(CommandLib::PauseCommand::Create(60)); // keeps the rest queued
+					dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 0));
+					std::this_thread::sleep_for(std::chrono::milliseconds(25));
+					CommandLib::CommandDispatcher::DispatchOptions options;
+					options.priority = priority;
+					options.deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+
+					for (int i = 1; i <= 5; ++i)
+					{
+						dispatcher.Dispatch(OrderRecordingCommand::Create(&log, i), options);
+					}
+				}
+
+				Assert::AreEqual(6U, (unsigned int)log.Ids().size());
+				Assert::AreEqual(0, log.Ids().front());
+			}
+		}
+
+		TEST_METHOD(CommandDispatcher_TestDeadlinesWhileSaturated)
+		{
+			// Expiry is reported when the deadline passes, even while the pool stays full, and expired commands make room in a
+			// full backlog before any live one is dropped
+			Monitor monitor;
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				dispatcher.AddMonitor(&monitor);
+				dispatcher.SetBacklogLimit(2, CommandLib::CommandDispatcher::OverflowPolicy::DropOldest);
+				CommandLib::DispatchHandle blocker = dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)));
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1));
+
+				CommandLib::CommandDispatcher::DispatchOptions options;
+				options.tag = "other";
+				options.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+				CommandLib::DispatchHandle expiring = dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 2), options);
+				Assert::IsTrue(expiring.Wait(std::chrono::seconds(5)));
+				Assert::IsTrue(expiring.GetOutcome() == CommandLib::DispatchHandle::Outcome::Failed);
+				Assert::IsTrue(blocker.GetOutcome() == CommandLib::DispatchHandle::Outcome::Pending);
+
+				options.deadline = std::chrono::steady_clock::now();
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 3), options);
+				Assert::IsTrue(dispatcher.TryDispatch(OrderRecordingCommand::Create(&log, 4)));
+				blocker.Cancel();
+			}
+
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 1, 4 }));
+			Assert::AreEqual(2U, monitor.m_completed.operator size_t());
+			Assert::AreEqual(2U, monitor.m_failed.operator size_t());
+			Assert::AreEqual(1U, monitor.m_aborted.operator size_t());
+		}
+
+		TEST_METHOD(CommandDispatcher_TestLanes)
+		{
+			const int laneCount = 4;
+			const int perLane = 20;
+			OrderRecordingCommand::Log logs[laneCount];
+			std::atomic_int executing[laneCount];
+			std::atomic_bool overlapped[laneCount];
+			Monitor monitor;
+
+			for (int lane = 0; lane < laneCount; ++lane)
+			{
+				executing[lane] = 0;
+				overlapped[lane] = false;
+			}
+
+			{
+				CommandLib::CommandDispatcher dispatcher(8);
+				dispatcher.AddMonitor(&monitor);
+
+				for (int i = 0; i < perLane; ++i)
+				{
+					for (int lane = 0; lane < laneCount; ++lane)
+					{
+						CommandLib::CommandDispatcher::DispatchOptions options;
+						options.lane = "lane" + std::to_string(lane);
+
+						// A failure along the way does not stop the rest of the lane
+						if (lane == 0 && i == 5)
+						{
+							dispatcher.Dispatch(CommandLibTests::FailingCommand::Create(), options);
+						}
+
+						dispatcher.Dispatch(SerialCheckCommand::Create(&logs[lane], i, &executing[lane], &overlapped[lane]), options);
+					}
+				}
+			}
+
+			for (int lane = 0; lane < laneCount; ++lane)
+			{
+				Assert::IsFalse(overlapped[lane]);
+				const std::vector<int> ids = logs[lane].Ids();
+				Assert::AreEqual(size_t(perLane), ids.size());
+
+				for (int i = 0; i < perLane; ++i)
+				{
+					Assert::AreEqual(i, ids[i]);
+				}
+			}
+
+			Assert::AreEqual(unsigned(laneCount * perLane), monitor.m_completed.operator unsigned());
+			Assert::AreEqual(1U, monitor.m_failed.operator size_t());
+		}
+
+		TEST_METHOD(CommandDispatcher_TestLanesAbort)
+		{
+			Monitor monitor;
+			OrderRecordingCommand::Log log;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(2);
+				dispatcher.AddMonitor(&monitor);
+				CommandLib::CommandDispatcher::DispatchOptions options;
+				options.lane = "a";
+				dispatcher.Dispatch(CommandLib::PauseCommand::Create(std::chrono::hours(24)), options);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 1), options);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 2), options);
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				dispatcher.AbortAndWait();
+
+				// The lane is usable afterwards
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 3), options);
+				dispatcher.Dispatch(OrderRecordingCommand::Create(&log, 4), options);
+			}
+
+			Assert::IsTrue(log.Ids() == std::vector<int>({ 3, 4 }));
+			Assert::AreEqual(1U, monitor.m_aborted.operator size_t());
+			Assert::AreEqual(2U, monitor.m_completed.operator size_t());
+		}
+
 		TEST_METHOD(CommandDispatcher_TestBadArgs)
 		{
 			Assert::ExpectException<std::invalid_argument>([](){ CommandLib::CommandDispatcher(0); }, L"Dispatcher with 0 pool size constructed");
@@ -171,6 +716,14 @@ namespace UnitTest
 			CommandLib::SequentialCommands::Ptr seq = CommandLib::SequentialCommands::Create();
 			seq->Add(pauseCmd);
 			Assert::ExpectException<std::invalid_argument>([&dispatcher, seq, pauseCmd](){ dispatcher.Dispatch(pauseCmd); }, L"Dispatched a child command.");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetAgingInterval(-1); }, L"Negative aging interval");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetBacklogWatermarks(5, 5); }, L"Watermarks out of order");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetAdaptiveConcurrency(0, 5); }, L"Zero minimum limit");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetAdaptiveConcurrency(5, 4); }, L"Limits out of order");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetAdaptiveConcurrency(1, 4, 1); }, L"No latency tolerance");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetRateLimit(-1, 1); }, L"Negative rate");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetRateLimit("tag", 10, 0); }, L"No burst");
+			Assert::ExpectException<std::invalid_argument>([&dispatcher](){ dispatcher.SetTagWeight("tag", 0); }, L"Zero weight");
 		}
 	};
 }
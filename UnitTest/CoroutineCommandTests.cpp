@@ -0,0 +1,151 @@
+#include "CppUnitTest.h"
+#include "CoroutineCommand.h"
+#include "AsyncPauseCommand.h"
+#include "ParallelCommands.h"
+#include "CommonTests.h"
+#include "CmdListener.h"
+#include "AddCommand.h"
+#include "FailingCommand.h"
+#include <atomic>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	class TestCoroutineCommand : public CommandLib::CoroutineCommand
+	{
+	public:
+		typedef std::shared_ptr<TestCoroutineCommand> Ptr;
+		enum class BodyType { AddAfterPause, Fail, RecoverFromFailure, PollAbortFlag };
+
+		static Ptr Create(BodyType bodyType, long long pauseMS, std::atomic_int* total)
+		{
+			return Ptr(new TestCoroutineCommand(bodyType, pauseMS, total));
+		}
+
+		virtual std::string ClassName() const override
+		{
+			return "TestCoroutineCommand";
+		}
+	protected:
+		virtual Task ExecuteCoroutine() override
+		{
+			switch (m_bodyType)
+			{
+			case BodyType::AddAfterPause:
+				co_await m_pause;
+				co_await m_add;
+				co_await m_add; // the same command may be awaited again as soon as it finishes
+				break;
+			case BodyType::Fail:
+				co_await m_add;
+				co_await m_fail;
+				co_await m_add;
+				break;
+			case BodyType::RecoverFromFailure:
+			{
+				bool failed = false;
+
+				try
+				{
+					co_await m_fail;
+				}
+				catch (CommandLibTests::FailingCommand::FailException&)
+				{
+					failed = true; // co_await is not permitted within a handler
+				}
+
+				if (failed)
+				{
+					co_await m_add;
+				}
+
+				break;
+			}
+			case BodyType::PollAbortFlag:
+				while (true)
+				{
+					CheckAbortFlag();
+					co_await CommandLib::AsyncPauseCommand::Create(1); // top-level, so an abort is only noticed by polling
+				}
+			}
+		}
+	private:
+		TestCoroutineCommand(BodyType bodyType, long long pauseMS, std::atomic_int* total)
+			: m_bodyType(bodyType),
+			m_pause(CommandLib::AsyncPauseCommand::Create(pauseMS)),
+			m_add(CommandLibTests::AddCommand::Create(total, 1)),
+			m_fail(CommandLibTests::FailingCommand::Create())
+		{
+			TakeOwnership(m_pause);
+			TakeOwnership(m_add);
+			TakeOwnership(m_fail);
+		}
+
+		const BodyType m_bodyType;
+		const CommandLib::AsyncPauseCommand::Ptr m_pause;
+		const CommandLibTests::AddCommand::Ptr m_add;
+		const CommandLibTests::FailingCommand::Ptr m_fail;
+	};
+
+	TEST_CLASS(CoroutineCommandTests)
+	{
+	public:
+		TEST_METHOD(CoroutineCommand_TestHappyPath)
+		{
+			std::atomic_int total;
+			total = 0;
+			TestCoroutineCommand::Ptr cmd = TestCoroutineCommand::Create(TestCoroutineCommand::BodyType::AddAfterPause, 1, &total);
+			CommonTests::TestHappyPath(cmd);
+			Assert::AreEqual(4, (int)total); // TestHappyPath() executes twice
+
+			total = 0;
+			cmd = TestCoroutineCommand::Create(TestCoroutineCommand::BodyType::RecoverFromFailure, 0, &total);
+			CommonTests::TestHappyPath(cmd);
+			Assert::AreEqual(2, (int)total);
+		}
+
+		TEST_METHOD(CoroutineCommand_TestFail)
+		{
+			std::atomic_int total;
+			total = 0;
+			TestCoroutineCommand::Ptr cmd = TestCoroutineCommand::Create(TestCoroutineCommand::BodyType::Fail, 0, &total);
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(cmd);
+			Assert::AreEqual(3, (int)total); // TestFail() executes three times, and the body stops at the failure each time
+		}
+
+		TEST_METHOD(CoroutineCommand_TestAbort)
+		{
+			std::atomic_int total;
+			total = 0;
+			TestCoroutineCommand::Ptr cmd = TestCoroutineCommand::Create(
+				TestCoroutineCommand::BodyType::AddAfterPause,
+				std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::hours(24)).count(),
+				&total);
+
+			CommonTests::TestAbort(cmd, 10);
+			Assert::AreEqual(0, (int)total);
+
+			cmd = TestCoroutineCommand::Create(TestCoroutineCommand::BodyType::PollAbortFlag, 0, &total);
+			CommonTests::TestAbort(cmd, 10);
+		}
+
+		TEST_METHOD(CoroutineCommand_TestManyPending)
+		{
+			// Far more coroutines than there are pool threads. None of them should hold a thread while awaiting.
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+			std::atomic_int total;
+			total = 0;
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				parallelCmds->Add(TestCoroutineCommand::Create(TestCoroutineCommand::BodyType::AddAfterPause, 100, &total));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			parallelCmds->SyncExecute();
+			Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+			Assert::AreEqual(2000, (int)total);
+		}
+	};
+}
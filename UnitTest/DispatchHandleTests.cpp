@@ -0,0 +1,134 @@
+#include "CppUnitTest.h"
+#include "CommandDispatcher.h"
+#include "CommandAbortedException.h"
+#include "CommandTimeoutException.h"
+#include "AddCommand.h"
+#include "AsyncPauseCommand.h"
+#include "PauseCommand.h"
+#include "FailingCommand.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(DispatchHandleTests)
+	{
+	public:
+		TEST_METHOD(DispatchHandle_TestOutcomes)
+		{
+			std::atomic_int total;
+			total = 0;
+			CommandLib::CommandDispatcher dispatcher(2);
+
+			CommandLib::DispatchHandle succeeded = dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 1));
+			succeeded.Get();
+			Assert::IsTrue(succeeded.GetOutcome() == CommandLib::DispatchHandle::Outcome::Succeeded);
+			Assert::IsTrue(succeeded.Error() == nullptr);
+			Assert::AreEqual(1, (int)total);
+
+			CommandLib::DispatchHandle failed = dispatcher.Dispatch(CommandLibTests::FailingCommand::Create());
+			Assert::ExpectException<CommandLibTests::FailingCommand::FailException>([&failed]() { failed.Get(); });
+			Assert::IsTrue(failed.GetOutcome() == CommandLib::DispatchHandle::Outcome::Failed);
+			Assert::IsTrue(failed.Error() != nullptr);
+
+			CommandLib::DispatchHandle aborted = dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)));
+			Assert::IsFalse(aborted.Wait(10));
+			Assert::IsTrue(aborted.GetOutcome() == CommandLib::DispatchHandle::Outcome::Pending);
+			dispatcher.Abort();
+			Assert::ExpectException<CommandLib::CommandAbortedException>([&aborted]() { aborted.Get(); });
+			Assert::IsTrue(aborted.GetOutcome() == CommandLib::DispatchHandle::Outcome::Aborted);
+
+			// Copies refer to the same dispatch
+			CommandLib::DispatchHandle copy = aborted;
+			Assert::IsTrue(copy.DoneEvent()->IsSignaled());
+
+			CommandLib::DispatchHandle none;
+			Assert::IsFalse(none.IsValid());
+			Assert::ExpectException<std::logic_error>([&none]() { none.Wait(); });
+		}
+
+		TEST_METHOD(DispatchHandle_TestCancel)
+		{
+			std::atomic_int total;
+			total = 0;
+			CommandLib::CommandDispatcher dispatcher(1);
+			CommandLib::DispatchHandle running = dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)));
+			CommandLib::DispatchHandle queued = dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 1));
+			CommandLib::DispatchHandle next = dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 2));
+
+			// A queued command is never started, and does not hold up the others
+			queued.Cancel();
+			running.Cancel();
+			next.Get();
+			Assert::IsTrue(running.GetOutcome() == CommandLib::DispatchHandle::Outcome::Aborted);
+			Assert::IsTrue(queued.GetOutcome() == CommandLib::DispatchHandle::Outcome::Aborted);
+			Assert::AreEqual(2, (int)total);
+
+			// Too late to matter
+			next.Cancel();
+			Assert::IsTrue(next.GetOutcome() == CommandLib::DispatchHandle::Outcome::Succeeded);
+
+			// A cancelled command waiting in a lane is skipped as well
+			CommandLib::CommandDispatcher::DispatchOptions options;
+			options.lane = "lane";
+			CommandLib::DispatchHandle first = dispatcher.Dispatch(CommandLib::PauseCommand::Create(20), options);
+			CommandLib::DispatchHandle second = dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 4), options);
+			CommandLib::DispatchHandle third = dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 8), options);
+			second.Cancel();
+			third.Get();
+			first.Get();
+			Assert::ExpectException<CommandLib::CommandAbortedException>([&second]() { second.Get(); });
+			Assert::AreEqual(10, (int)total);
+		}
+
+		TEST_METHOD(DispatchHandle_TestDiscarded)
+		{
+			CommandLib::CommandDispatcher dispatcher(1);
+			dispatcher.Dispatch(CommandLib::PauseCommand::Create(50)); // keeps the rest queued
+
+			CommandLib::CommandDispatcher::DispatchOptions options;
+			options.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+			CommandLib::DispatchHandle expired = dispatcher.Dispatch(CommandLib::PauseCommand::Create(0), options);
+			Assert::ExpectException<CommandLib::CommandTimeoutException>([&expired]() { expired.Get(); });
+			Assert::IsTrue(expired.GetOutcome() == CommandLib::DispatchHandle::Outcome::Failed);
+
+			// Commands emptied from the backlog by Abort() are not reported to the monitors, but their handles are completed
+			dispatcher.Dispatch(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)));
+			CommandLib::DispatchHandle cleared = dispatcher.Dispatch(CommandLib::PauseCommand::Create(0));
+			dispatcher.AbortAndWait();
+			Assert::IsTrue(cleared.DoneEvent()->IsSignaled());
+			Assert::IsTrue(cleared.GetOutcome() == CommandLib::DispatchHandle::Outcome::Aborted);
+		}
+
+		TEST_METHOD(DispatchHandle_TestCommandNotKeptAlive)
+		{
+			std::weak_ptr<CommandLib::Command> weakCommand;
+			CommandLib::DispatchHandle handle;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(1);
+				CommandLib::Command::Ptr command = CommandLib::PauseCommand::Create(0);
+				weakCommand = command;
+				handle = dispatcher.Dispatch(command);
+				handle.Get();
+			}
+
+			// The handle outlives both the dispatcher and the command. The last reference to the command may be dropped by a
+			// pool thread just after the dispatcher is done with it, so allow it a moment.
+			const std::chrono::steady_clock::time_point giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+			while (!weakCommand.expired() && std::chrono::steady_clock::now() < giveUp)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			Assert::IsTrue(weakCommand.expired());
+			Assert::IsTrue(handle.GetOutcome() == CommandLib::DispatchHandle::Outcome::Succeeded);
+			handle.Cancel();
+		}
+	};
+}
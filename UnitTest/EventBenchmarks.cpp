@@ -0,0 +1,211 @@
+#include "CppUnitTest.h"
+#include "Event.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	// The Event implementation that preceded the atomic state word, kept here as the baseline for comparison
+	class LegacyEvent : public CommandLib::Waitable
+	{
+	public:
+		LegacyEvent() : m_signaled(false), m_notifying(0)
+		{
+		}
+
+		virtual ~LegacyEvent()
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_notifying == 0; });
+		}
+
+		void Set()
+		{
+			{
+				std::unique_lock<std::recursive_mutex> lock(m_mutex);
+				m_signaled = true;
+				++m_notifying;
+				m_condition.notify_all();
+			}
+
+			NotifyListeners();
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+			--m_notifying;
+			m_condition.notify_all();
+		}
+
+		void Reset()
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+			m_signaled = false;
+		}
+
+		virtual bool IsSignaled() const override final
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+			return m_signaled;
+		}
+
+		virtual void Wait() const override final
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+
+			while (!m_signaled)
+			{
+				m_condition.wait(lock);
+			}
+		}
+
+		virtual bool Wait(long long ms) const override final
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
+
+			while (!m_signaled)
+			{
+				if (m_condition.wait_for(lock, std::chrono::milliseconds(ms)) == std::cv_status::timeout)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+	private:
+		bool m_signaled;
+		int m_notifying;
+		mutable std::condition_variable_any m_condition;
+		mutable std::recursive_mutex m_mutex;
+	};
+
+	TEST_CLASS(EventBenchmarks)
+	{
+	public:
+		TEST_METHOD(EventBenchmarks_IsSignaledUnderContention)
+		{
+			const double legacyNS = PollWhileToggling<LegacyEvent>();
+			const double currentNS = PollWhileToggling<CommandLib::Event>();
+			Report("IsSignaled() while another thread toggles the event", legacyNS, currentNS, "ns per call");
+		}
+
+		TEST_METHOD(EventBenchmarks_WaitSetPingPong)
+		{
+			const double legacyNS = PingPong<LegacyEvent>();
+			const double currentNS = PingPong<CommandLib::Event>();
+			Report("Wait()/Set() round trip between two threads", legacyNS, currentNS, "ns per round trip");
+		}
+	private:
+		static const int PollsPerThread = 200000;
+		static const int RoundTrips = 5000;
+
+		template<typename EventType>
+		static double PollWhileToggling()
+		{
+			EventType ev;
+			std::atomic_bool done(false);
+			std::atomic_int signaledCount(0);
+			std::atomic_int finishedCount(0);
+			std::atomic_bool released(false);
+			std::atomic_int observedCount(0);
+			const unsigned int pollerCount = std::max(2U, std::thread::hardware_concurrency());
+
+			std::thread toggler([&ev, &done]()
+			{
+				while (!done)
+				{
+					ev.Set();
+					ev.Reset();
+				}
+			});
+
+			const auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> pollers;
+
+			for (unsigned int i = 0; i < pollerCount; ++i)
+			{
+				pollers.push_back(std::thread([&ev, &signaledCount, &finishedCount, &released, &observedCount]()
+				{
+					int count = 0;
+
+					for (int j = 0; j < PollsPerThread; ++j)
+					{
+						count += ev.IsSignaled() ? 1 : 0;
+					}
+
+					signaledCount += count; // so that the polls cannot be optimized away
+					++finishedCount;
+
+					// Once the toggling has stopped, the event is set for good, and every poller must see it as soon as it learns so
+					while (!released)
+					{
+						std::this_thread::yield();
+					}
+
+					observedCount += ev.IsSignaled() ? 1 : 0;
+				}));
+			}
+
+			while (finishedCount < static_cast<int>(pollerCount))
+			{
+				std::this_thread::yield();
+			}
+
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			done = true;
+			toggler.join();
+			ev.Set();
+			released = true;
+
+			for (std::thread& poller : pollers)
+			{
+				poller.join();
+			}
+
+			Assert::AreEqual(static_cast<int>(pollerCount), static_cast<int>(observedCount));
+			return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / (static_cast<double>(pollerCount) * PollsPerThread);
+		}
+
+		template<typename EventType>
+		static double PingPong()
+		{
+			EventType ping;
+			EventType pong;
+
+			std::thread responder([&ping, &pong]()
+			{
+				for (int i = 0; i < RoundTrips; ++i)
+				{
+					ping.Wait();
+					ping.Reset();
+					pong.Set();
+				}
+			});
+
+			const auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < RoundTrips; ++i)
+			{
+				ping.Set();
+				pong.Wait();
+				pong.Reset();
+			}
+
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			responder.join();
+			return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / RoundTrips;
+		}
+
+		static void Report(const char* name, double legacy, double current, const char* unit)
+		{
+			std::ostringstream message;
+			message << name << ": legacy " << legacy << ", current " << current << " " << unit << std::endl;
+			Logger::WriteMessage(message.str().c_str());
+		}
+	};
+}
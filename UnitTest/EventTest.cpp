@@ -3,6 +3,7 @@
 #include "WaitMonitor.h"
 #include <thread>
 #include <atomic>
+#include <vector>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -89,6 +90,42 @@ namespace UnitTest
 			Assert::IsTrue(ev.WaitFor(std::chrono::nanoseconds(0)));
 		}
 
+		TEST_METHOD(EventTest_TestManyWaiters)
+		{
+			CommandLib::Event ev;
+			std::atomic_int released;
+			released = 0;
+			std::vector<std::thread> threads;
+
+			for (int i = 0; i < 8; ++i)
+			{
+				threads.push_back(std::thread([&ev, &released, i]()
+				{
+					if (i % 2 == 0)
+					{
+						ev.Wait();
+					}
+					else
+					{
+						Assert::IsTrue(ev.WaitFor(std::chrono::hours(24)));
+					}
+
+					++released;
+				}));
+			}
+
+			Assert::IsFalse(ev.Wait(50));
+			Assert::AreEqual(0, (int)released);
+			ev.Set();
+
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			Assert::AreEqual(8, (int)released);
+		}
+
 		TEST_METHOD(EventTest_TestAddListener)
 		{
 			std::shared_ptr<TestMonitor> monitor(new TestMonitor());
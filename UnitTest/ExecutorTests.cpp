@@ -0,0 +1,112 @@
+#include "CppUnitTest.h"
+#include "Executor.h"
+#include "ThreadPool.h"
+#include "CommandDispatcher.h"
+#include "ParallelCommands.h"
+#include "SequentialCommands.h"
+#include "AddCommand.h"
+#include "PauseCommand.h"
+#include "CommonTests.h"
+#include <atomic>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	class CountingExecutor : public CommandLib::Executor
+	{
+	public:
+		CountingExecutor() : m_pool(CommandLib::ThreadPool::Create(2))
+		{
+			m_executeCount = 0;
+		}
+
+		virtual void Execute(std::function<void()> task) override
+		{
+			++m_executeCount;
+			m_pool->Execute(task);
+		}
+
+		std::atomic_int m_executeCount;
+	private:
+		CommandLib::ThreadPool::Ptr m_pool;
+	};
+
+	TEST_CLASS(ExecutorTests)
+	{
+	public:
+		TEST_METHOD(Executor_TestInheritance)
+		{
+			std::shared_ptr<CountingExecutor> executor(new CountingExecutor());
+			CommandLib::SequentialCommands::Ptr seqCmds = CommandLib::SequentialCommands::Create();
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(false);
+			std::atomic_int total;
+			total = 0;
+			CommandLibTests::AddCommand::Ptr addCmd = CommandLibTests::AddCommand::Create(&total, 1);
+			parallelCmds->Add(addCmd);
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			seqCmds->Add(parallelCmds);
+			seqCmds->SetExecutor(executor);
+			Assert::IsTrue(addCmd->GetExecutor() == executor);
+			Assert::ExpectException<std::logic_error>([addCmd, executor]() { addCmd->SetExecutor(executor); }, L"Set the executor of a child command");
+
+			CommonTests::TestHappyPath(seqCmds);
+			Assert::AreEqual((int)total, 4);
+			Assert::IsTrue(executor->m_executeCount > 0);
+
+			seqCmds->SetExecutor(CommandLib::Executor::Ptr());
+			Assert::IsTrue(addCmd->GetExecutor() == CommandLib::ThreadPool::Default());
+		}
+
+		TEST_METHOD(Executor_TestEmptyCollections)
+		{
+			std::shared_ptr<CountingExecutor> executor(new CountingExecutor());
+			CommandLib::SequentialCommands::Ptr seqCmds = CommandLib::SequentialCommands::Create();
+			seqCmds->SetExecutor(executor);
+			CommonTests::TestHappyPath(seqCmds);
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+			parallelCmds->SetExecutor(executor);
+			CommonTests::TestHappyPath(parallelCmds);
+
+			// Once for each asynchronous execution, plus once for the synchronous execution of ParallelCommands (which is naturally asynchronous)
+			Assert::AreEqual((int)executor->m_executeCount, 3);
+		}
+
+		TEST_METHOD(Executor_TestDispatcher)
+		{
+			std::shared_ptr<CountingExecutor> executor(new CountingExecutor());
+			std::atomic_int total;
+			total = 0;
+
+			{
+				CommandLib::CommandDispatcher dispatcher(2, executor);
+
+				for (int i = 0; i < 5; ++i)
+				{
+					dispatcher.Dispatch(CommandLibTests::AddCommand::Create(&total, 1));
+				}
+			}
+
+			Assert::AreEqual((int)total, 5);
+			Assert::AreEqual((int)executor->m_executeCount, 5);
+		}
+
+		TEST_METHOD(Executor_TestSyncStepAfterAsyncStep)
+		{
+			// This executor cannot tell its own threads apart, so the step after the asynchronous one is handed off to it, and
+			// must then run there rather than be handed off again
+			std::shared_ptr<CountingExecutor> executor(new CountingExecutor());
+			CommandLib::SequentialCommands::Ptr seqCmds = CommandLib::SequentialCommands::Create();
+			std::atomic_int total;
+			total = 0;
+			seqCmds->Add(CommandLib::ParallelCommands::Create(false));
+			seqCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			seqCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			seqCmds->SetExecutor(executor);
+
+			CommonTests::TestHappyPath(seqCmds);
+			Assert::AreEqual((int)total, 4);
+			Assert::IsTrue(executor->m_executeCount < 10);
+		}
+	};
+}
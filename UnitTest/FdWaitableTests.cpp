@@ -0,0 +1,193 @@
+#include "CppUnitTest.h"
+#ifdef __linux__
+#include "FdWaitable.h"
+#include "EventFdWaitable.h"
+#include "Event.h"
+#include "WaitGroup.h"
+#include "PauseCommand.h"
+#include "AsyncPauseCommand.h"
+#include "ParallelCommands.h"
+#include "CmdListener.h"
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	class Pipe
+	{
+	public:
+		Pipe()
+		{
+			Assert::AreEqual(0, pipe(m_fds));
+		}
+
+		~Pipe()
+		{
+			close(m_fds[0]);
+			close(m_fds[1]);
+		}
+
+		int ReadFd() const { return m_fds[0]; }
+		int WriteFd() const { return m_fds[1]; }
+
+		void WriteByte() const
+		{
+			const char byte = 0;
+			Assert::AreEqual(1L, static_cast<long>(write(m_fds[1], &byte, 1)));
+		}
+
+		void ReadByte() const
+		{
+			char byte;
+			Assert::AreEqual(1L, static_cast<long>(read(m_fds[0], &byte, 1)));
+		}
+	private:
+		int m_fds[2];
+	};
+
+	TEST_CLASS(FdWaitableTests)
+	{
+	public:
+		TEST_METHOD(FdWaitable_TestReadable)
+		{
+			Pipe pipe;
+			CommandLib::FdWaitable::Ptr readable = CommandLib::FdWaitable::Create(pipe.ReadFd(), CommandLib::FdWaitable::Condition::Readable);
+			Assert::IsFalse(readable->IsSignaled());
+			Assert::IsFalse(readable->Wait(10));
+
+			std::thread thread([&pipe]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				pipe.WriteByte();
+			});
+
+			readable->Wait();
+			thread.join();
+			Assert::IsTrue(readable->IsSignaled());
+			pipe.ReadByte();
+			Assert::IsFalse(readable->IsSignaled());
+		}
+
+		TEST_METHOD(FdWaitable_TestWritable)
+		{
+			Pipe pipe;
+			CommandLib::FdWaitable::Ptr writable = CommandLib::FdWaitable::Create(pipe.WriteFd(), CommandLib::FdWaitable::Condition::Writable);
+			Assert::IsTrue(writable->IsSignaled());
+			Assert::IsTrue(writable->WaitFor(std::chrono::milliseconds(0)));
+
+			// Several waitables may watch the same descriptor
+			CommandLib::FdWaitable::Ptr another = CommandLib::FdWaitable::Create(pipe.WriteFd(), CommandLib::FdWaitable::Condition::Writable);
+			Assert::IsTrue(another->IsSignaled());
+		}
+
+		TEST_METHOD(FdWaitable_TestWaitGroup)
+		{
+			Pipe pipe;
+			CommandLib::Event::Ptr ev(new CommandLib::Event());
+			CommandLib::EventFdWaitable::Ptr eventFd = CommandLib::EventFdWaitable::Create();
+			CommandLib::WaitGroup group;
+			group.AddWaitable(ev);
+			group.AddWaitable(CommandLib::FdWaitable::Create(pipe.ReadFd(), CommandLib::FdWaitable::Condition::Readable));
+			group.AddWaitable(eventFd);
+			Assert::AreEqual(-1, group.WaitForAny(10));
+
+			for (int i = 0; i < 10; ++i)
+			{
+				std::thread thread([&pipe, eventFd, i]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+					if (i % 2 == 0)
+					{
+						pipe.WriteByte();
+					}
+					else
+					{
+						eventFd->Set();
+					}
+				});
+
+				Assert::AreEqual(i % 2 == 0 ? 1 : 2, group.WaitForAny());
+				thread.join();
+
+				if (i % 2 == 0)
+				{
+					pipe.ReadByte();
+				}
+				else
+				{
+					eventFd->Reset();
+				}
+			}
+		}
+
+		TEST_METHOD(FdWaitable_TestPauseStopEvent)
+		{
+			Pipe pipe;
+			CommandLib::FdWaitable::Ptr readable = CommandLib::FdWaitable::Create(pipe.ReadFd(), CommandLib::FdWaitable::Condition::Readable);
+			CommandLib::PauseCommand::Ptr pause = CommandLib::PauseCommand::Create(std::chrono::hours(24), readable);
+
+			std::thread thread([&pipe]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				pipe.WriteByte();
+			});
+
+			pause->SyncExecute();
+			thread.join();
+		}
+
+		TEST_METHOD(FdWaitable_TestManyPending)
+		{
+			// Far more descriptors than there are pool threads. None of them should hold a thread while waiting.
+			std::vector<CommandLib::EventFdWaitable::Ptr> events;
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+
+			for (int i = 0; i < 200; ++i)
+			{
+				events.push_back(CommandLib::EventFdWaitable::Create());
+				parallelCmds->Add(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24), events.back()));
+			}
+
+			CmdListener listener(CmdListener::CallbackType::Succeeded);
+			parallelCmds->AsyncExecute(&listener);
+			Assert::IsFalse(parallelCmds->Wait(20));
+
+			for (CommandLib::EventFdWaitable::Ptr& ev : events)
+			{
+				ev->Set();
+			}
+
+			Assert::IsTrue(parallelCmds->Wait(std::chrono::seconds(5)));
+			listener.Check();
+		}
+	};
+
+	TEST_CLASS(EventFdWaitableTests)
+	{
+	public:
+		TEST_METHOD(EventFdWaitable_TestSetAndReset)
+		{
+			CommandLib::EventFdWaitable::Ptr ev = CommandLib::EventFdWaitable::Create();
+			Assert::IsFalse(ev->IsSignaled());
+			ev->Set();
+			ev->Set();
+			Assert::IsTrue(ev->IsSignaled());
+			Assert::IsTrue(ev->Wait(0));
+			ev->Reset();
+			Assert::IsFalse(ev->IsSignaled());
+			ev->Reset();
+			Assert::IsFalse(ev->Wait(10));
+			Assert::IsTrue(CommandLib::EventFdWaitable::Create(true)->IsSignaled());
+
+			// The descriptor may be signaled by code that knows nothing of this library
+			const uint64_t one = 1;
+			Assert::AreEqual(static_cast<long>(sizeof(one)), static_cast<long>(write(ev->Fd(), &one, sizeof(one))));
+			Assert::IsTrue(ev->IsSignaled());
+		}
+	};
+}
+#endif
@@ -0,0 +1,170 @@
+#include "CppUnitTest.h"
+#include "HedgedCommand.h"
+#include "CommonTests.h"
+#include "AddCommand.h"
+#include "PauseCommand.h"
+#include "FailingCommand.h"
+#include "AsyncCommand.h"
+#include "CommandAbortedException.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	// Reports that it was aborted, without anybody having aborted it
+	class SelfAbortingCommand : public CommandLib::AsyncCommand
+	{
+	public:
+		typedef std::shared_ptr<SelfAbortingCommand> Ptr;
+		static Ptr Create() { return Ptr(new SelfAbortingCommand()); }
+		virtual std::string ClassName() const override { return "SelfAbortingCommand"; }
+	private:
+		SelfAbortingCommand() {}
+
+		virtual void AsyncExecuteImpl(CommandLib::CommandListener* listener) override final
+		{
+			CommandLib::Command::Ptr thisCommand = shared_from_this();
+			GetExecutor()->Execute([thisCommand, listener]() { listener->CommandAborted(); });
+		}
+	};
+
+	TEST_CLASS(HedgedCommandTests)
+	{
+	public:
+		TEST_METHOD(HedgedCommand_TestHappyPath)
+		{
+			// The first attempt finishes long before a backup is due
+			std::atomic_int total;
+			total = 0;
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create(
+				[&total]() { return CommandLibTests::AddCommand::Create(&total, 1); }, std::chrono::hours(24));
+
+			CommonTests::TestHappyPath(hedgedCmd);
+			Assert::AreEqual((int)total, 2);
+		}
+
+		TEST_METHOD(HedgedCommand_TestBackupWins)
+		{
+			// The first attempt hangs, so the backup must win, and the first must be aborted
+			std::atomic_int total;
+			total = 0;
+			int created = 0;
+
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create([&total, &created]()
+			{
+				return ++created == 1
+					? CommandLib::Command::Ptr(CommandLib::PauseCommand::Create(std::chrono::hours(24)))
+					: CommandLib::Command::Ptr(CommandLibTests::AddCommand::Create(&total, 1));
+			}, 10);
+
+			CommonTests::TestHappyPath(hedgedCmd);
+			Assert::AreEqual((int)total, 2);
+		}
+
+		TEST_METHOD(HedgedCommand_TestFail)
+		{
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create(
+				[]() { return CommandLibTests::FailingCommand::Create(); }, 3, 10, 95);
+
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(hedgedCmd);
+
+			// A failed attempt is followed by the next without waiting for the delay
+			std::atomic_int total;
+			total = 0;
+			int created = 0;
+
+			hedgedCmd = CommandLib::HedgedCommand::Create([&total, &created]()
+			{
+				return ++created == 1
+					? CommandLib::Command::Ptr(CommandLibTests::FailingCommand::Create())
+					: CommandLib::Command::Ptr(CommandLibTests::AddCommand::Create(&total, 1));
+			}, std::chrono::hours(24));
+
+			CommonTests::TestHappyPath(hedgedCmd);
+			Assert::AreEqual((int)total, 2);
+		}
+
+		TEST_METHOD(HedgedCommand_TestAbort)
+		{
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create(
+				[]() { return CommandLib::PauseCommand::Create(std::chrono::hours(24)); }, 3, 5, 95);
+
+			CommonTests::TestAbort(hedgedCmd, 20);
+		}
+
+		TEST_METHOD(HedgedCommand_TestAttemptAbortsItself)
+		{
+			// The only attempt launched ends before the backup is due, so the backup must never be launched
+			std::atomic_int total;
+			total = 0;
+			int created = 0;
+
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create([&total, &created]()
+			{
+				return ++created == 1
+					? CommandLib::Command::Ptr(SelfAbortingCommand::Create())
+					: CommandLib::Command::Ptr(CommandLibTests::AddCommand::Create(&total, 1));
+			}, 20);
+
+			Assert::ExpectException<CommandLib::CommandAbortedException>([hedgedCmd]() { hedgedCmd->SyncExecute(); });
+			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+			Assert::AreEqual((int)total, 0);
+		}
+
+		TEST_METHOD(HedgedCommand_TestAdaptiveDelay)
+		{
+			std::atomic_int total;
+			total = 0;
+			CommandLib::HedgedCommand::Ptr hedgedCmd = CommandLib::HedgedCommand::Create(
+				[&total]() { return CommandLibTests::AddCommand::Create(&total, 1); }, std::chrono::hours(24));
+
+			Assert::AreEqual(hedgedCmd->HedgeDelayMS(), 24LL * 60 * 60 * 1000);
+
+			for (int i = 0; i < 50; ++i)
+			{
+				hedgedCmd->SyncExecute();
+			}
+
+			// The delay now reflects how long the attempts actually take
+			Assert::IsTrue(hedgedCmd->HedgeDelayMS() >= 1);
+			Assert::IsTrue(hedgedCmd->HedgeDelayMS() < 10000);
+
+			// The first attempt is always slow, so the backups win. The caller still waited for the delay before each one started,
+			// so the delay must not fall below it to the backups' own (short) execution times.
+			int created = 0;
+
+			hedgedCmd = CommandLib::HedgedCommand::Create([&total, &created]()
+			{
+				return ++created == 1
+					? CommandLib::Command::Ptr(CommandLib::PauseCommand::Create(20))
+					: CommandLib::Command::Ptr(CommandLibTests::AddCommand::Create(&total, 1));
+			}, 5);
+
+			for (int i = 0; i < 40; ++i)
+			{
+				hedgedCmd->SyncExecute();
+			}
+
+			Assert::IsTrue(hedgedCmd->HedgeDelayMS() >= 5);
+			Assert::IsTrue(hedgedCmd->HedgeDelayMS() < 10000);
+		}
+
+		TEST_METHOD(HedgedCommand_TestBadArgs)
+		{
+			CommandLib::HedgedCommand::CommandFactory factory = []() { return CommandLib::PauseCommand::Create(0); };
+			Assert::ExpectException<std::invalid_argument>([factory]() { CommandLib::HedgedCommand::Create(factory, 0, 10, 95); }, L"No attempts");
+			Assert::ExpectException<std::invalid_argument>([factory]() { CommandLib::HedgedCommand::Create(factory, 2, -1, 95); }, L"Negative delay");
+			Assert::ExpectException<std::invalid_argument>([factory]() { CommandLib::HedgedCommand::Create(factory, 2, 10, 0); }, L"Zero percentile");
+			Assert::ExpectException<std::invalid_argument>([factory]() { CommandLib::HedgedCommand::Create(factory, 2, 10, 101); }, L"Percentile over 100");
+
+			Assert::ExpectException<std::invalid_argument>([]()
+			{
+				CommandLib::HedgedCommand::Create([]() { return CommandLib::Command::Ptr(); }, 10);
+			}, L"Factory returned null");
+		}
+	};
+}
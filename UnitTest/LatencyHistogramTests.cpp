@@ -0,0 +1,73 @@
+#include "CppUnitTest.h"
+#include "LatencyHistogram.h"
+#include <stdexcept>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(LatencyHistogramTests)
+	{
+	public:
+		TEST_METHOD(LatencyHistogram_TestPercentiles)
+		{
+			CommandLib::LatencyHistogram histogram(1000000);
+			Assert::AreEqual(0LL, histogram.Percentile(50));
+
+			for (long long i = 1; i <= 1000; ++i)
+			{
+				histogram.Record(i);
+			}
+
+			Assert::AreEqual((long long)histogram.Count(), 1000LL);
+
+			// A reported percentile is never below the true value, and never more than 25% above it
+			const long long median = histogram.Percentile(50);
+			Assert::IsTrue(median >= 500 && median <= 625);
+			const long long p99 = histogram.Percentile(99);
+			Assert::IsTrue(p99 >= 990 && p99 <= 1238);
+			Assert::IsTrue(histogram.Percentile(100) >= 1000);
+
+			// Small values are exact
+			CommandLib::LatencyHistogram small(1000000);
+			small.Record(0);
+			small.Record(std::chrono::microseconds(3));
+			small.Record(-5);
+			Assert::AreEqual(0LL, small.Percentile(50));
+			Assert::AreEqual(3LL, small.Percentile(100));
+
+			// Huge values do not overflow
+			small.Record(std::chrono::hours(24 * 365 * 100));
+			Assert::IsTrue(small.Percentile(100) >= std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::hours(24 * 365 * 100)).count());
+		}
+
+		TEST_METHOD(LatencyHistogram_TestDecay)
+		{
+			CommandLib::LatencyHistogram histogram(100);
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				histogram.Record(std::chrono::microseconds(10));
+			}
+
+			Assert::IsTrue(histogram.Percentile(50) < 20);
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				histogram.Record(std::chrono::milliseconds(10));
+			}
+
+			// The old samples have faded away
+			Assert::IsTrue(histogram.Percentile(5) >= 10000);
+			Assert::IsTrue(histogram.Count() <= 200);
+		}
+
+		TEST_METHOD(LatencyHistogram_TestBadArgs)
+		{
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::LatencyHistogram histogram(0); }, L"No decay interval");
+			CommandLib::LatencyHistogram histogram(10);
+			Assert::ExpectException<std::invalid_argument>([&histogram]() { histogram.Percentile(0); }, L"Zero percentile");
+			Assert::ExpectException<std::invalid_argument>([&histogram]() { histogram.Percentile(100.5); }, L"Percentile over 100");
+		}
+	};
+}
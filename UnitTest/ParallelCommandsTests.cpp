@@ -5,11 +5,90 @@
 #include "AddCommand.h"
 #include "PauseCommand.h"
 #include "FailingCommand.h"
+#include "PeriodicCommand.h"
+#include "RetryableCommand.h"
+#include "SyncCommand.h"
+#include "AsyncCommand.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace UnitTest
 {
+	// Records the most instances that were ever running at once
+	class ConcurrencyCountingCommand : public CommandLib::SyncCommand
+	{
+	public:
+		typedef std::shared_ptr<ConcurrencyCountingCommand> Ptr;
+
+		static Ptr Create(std::atomic_int* running, std::atomic_int* maxRunning)
+		{
+			return Ptr(new ConcurrencyCountingCommand(running, maxRunning));
+		}
+
+		virtual std::string ClassName() const override { return "ConcurrencyCountingCommand"; }
+	private:
+		ConcurrencyCountingCommand(std::atomic_int* running, std::atomic_int* maxRunning) : m_running(running), m_maxRunning(maxRunning)
+		{
+		}
+
+		virtual void SyncExeImpl() override final
+		{
+			const int running = ++*m_running;
+			int maxRunning = *m_maxRunning;
+
+			while (running > maxRunning && !m_maxRunning->compare_exchange_weak(maxRunning, running))
+			{
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			--*m_running;
+		}
+
+		std::atomic_int* const m_running;
+		std::atomic_int* const m_maxRunning;
+	};
+
+	// Fails upon its first execution only
+	class FailOnceCommand : public CommandLib::SyncCommand
+	{
+	public:
+		typedef std::shared_ptr<FailOnceCommand> Ptr;
+		static Ptr Create() { return Ptr(new FailOnceCommand()); }
+		virtual std::string ClassName() const override { return "FailOnceCommand"; }
+	private:
+		FailOnceCommand() {}
+
+		virtual void SyncExeImpl() override final
+		{
+			if (!m_failed)
+			{
+				m_failed = true;
+				throw std::runtime_error("First execution");
+			}
+		}
+
+		bool m_failed = false;
+	};
+
+	// Cannot be launched
+	class UnlaunchableCommand : public CommandLib::AsyncCommand
+	{
+	public:
+		typedef std::shared_ptr<UnlaunchableCommand> Ptr;
+		static Ptr Create() { return Ptr(new UnlaunchableCommand()); }
+		virtual std::string ClassName() const override { return "UnlaunchableCommand"; }
+	private:
+		UnlaunchableCommand() {}
+
+		virtual void AsyncExecuteImpl(CommandLib::CommandListener*) override final
+		{
+			throw std::runtime_error("Cannot launch");
+		}
+	};
+
 	TEST_CLASS(ParallelCommandsTests)
 	{
 	public:
@@ -25,6 +104,161 @@ namespace UnitTest
 			TestAbort(true);
 		}
 
+		TEST_METHOD(ParallelCommands_TestMaxConcurrency)
+		{
+			std::atomic_int running;
+			std::atomic_int maxRunning;
+			running = 0;
+			maxRunning = 0;
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true, 3);
+
+			for (int i = 0; i < 50; ++i)
+			{
+				parallelCmds->Add(ConcurrencyCountingCommand::Create(&running, &maxRunning));
+			}
+
+			CommonTests::TestHappyPath(parallelCmds);
+			Assert::IsTrue(maxRunning <= 3);
+			Assert::IsTrue(maxRunning > 0);
+
+			// A limit larger than the collection is the same as no limit
+			parallelCmds = CommandLib::ParallelCommands::Create(false, 100);
+			std::atomic_int total;
+			total = 0;
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			CommonTests::TestHappyPath(parallelCmds);
+			Assert::AreEqual((int)total, 4);
+		}
+
+		TEST_METHOD(ParallelCommands_TestMaxConcurrencyAbortAndFail)
+		{
+			// The commands that were never started must not hold up the abort
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(false, 1);
+
+			for (int i = 0; i < 10; ++i)
+			{
+				parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			}
+
+			CommonTests::TestAbort(parallelCmds, 10);
+
+			// Nor the failure, when the collection aborts upon failure
+			parallelCmds = CommandLib::ParallelCommands::Create(true, 1);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+
+			for (int i = 0; i < 10; ++i)
+			{
+				parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			}
+
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(parallelCmds);
+
+			// Without abort upon failure, the rest still run
+			std::atomic_int total;
+			total = 0;
+			parallelCmds = CommandLib::ParallelCommands::Create(false, 1);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(parallelCmds);
+			Assert::AreEqual((int)total, 3);
+		}
+
+		TEST_METHOD(ParallelCommands_TestLaunchFailure)
+		{
+			// A wide fan-out hands ranges of commands off to the executor. A launch that fails to the caller must not leave any of
+			// them running.
+			std::atomic_int total;
+			total = 0;
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(false);
+			parallelCmds->Add(UnlaunchableCommand::Create());
+
+			for (int i = 0; i < 100; ++i)
+			{
+				parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			}
+
+			CmdListener listener(CmdListener::CallbackType::None);
+			Assert::ExpectException<std::runtime_error>([parallelCmds, &listener]() { parallelCmds->AsyncExecute(&listener); });
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			Assert::AreEqual((int)total, 0);
+		}
+
+		TEST_METHOD(ParallelCommands_TestRace)
+		{
+			// The first success wins, and the losers are aborted
+			std::atomic_int total;
+			total = 0;
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::CreateRace(1);
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			CommonTests::TestHappyPath(parallelCmds);
+			Assert::AreEqual((int)total, 2);
+
+			// A failure does not decide the race while a success is still possible
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(1);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			parallelCmds->Add(CommandLib::PauseCommand::Create(10));
+			CommonTests::TestHappyPath(parallelCmds);
+
+			// Quorum
+			total = 0;
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(2);
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			CommonTests::TestHappyPath(parallelCmds);
+			Assert::AreEqual((int)total, 4);
+
+			// The losers are aborted, but that must not leak into the next execution of the race by its owner
+			total = 0;
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(1);
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			CommandLib::PeriodicCommand::Ptr periodicCmd = CommandLib::PeriodicCommand::Create(
+				parallelCmds, 3, 0, CommandLib::PeriodicCommand::IntervalType::PauseAfter, false);
+			periodicCmd->SyncExecute();
+			Assert::AreEqual((int)total, 3);
+
+			// One at a time, falling back to the next upon failure
+			total = 0;
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(1, 1);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			CommonTests::TestHappyPath(parallelCmds);
+			Assert::AreEqual((int)total, 2);
+		}
+
+		TEST_METHOD(ParallelCommands_TestRaceLost)
+		{
+			// Once a quorum can no longer be reached, the rest are aborted
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::CreateRace(2);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(parallelCmds);
+
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(1);
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			CommonTests::TestAbort(parallelCmds, 10);
+
+			// The aborted ones must not stay aborted when the race is run again, as a retry would
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(2);
+			parallelCmds->Add(FailOnceCommand::Create());
+			parallelCmds->Add(CommandLib::PauseCommand::Create(50));
+			CommandLib::RetryableCommand::Ptr retryableCmd = CommandLib::RetryableCommand::Create(parallelCmds, 1, 0, 0);
+			retryableCmd->SyncExecute();
+
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::ParallelCommands::CreateRace(0); }, L"Race with no winner");
+			parallelCmds = CommandLib::ParallelCommands::CreateRace(2);
+			parallelCmds->Add(CommandLib::PauseCommand::Create(0));
+			Assert::ExpectException<std::logic_error>([parallelCmds]() { parallelCmds->SyncExecute(); }, L"Race that cannot be won");
+		}
+
 		TEST_METHOD(ParallelCommands_TestFail)
 		{
 			TestFail(false);
@@ -6,6 +6,9 @@
 #include "PauseCommand.h"
 #include "FailingCommand.h"
 #include "CommandTimeoutException.h"
+#include "AsyncPauseCommand.h"
+#include "ParallelCommands.h"
+#include "SequentialCommands.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -265,5 +268,32 @@ namespace UnitTest
             periodicCmd->Wait();
             listener.Check();
         }
+
+		TEST_METHOD(PeriodicCommand_TestManyPending)
+		{
+			// Far more periodic commands than there are pool threads. None of them should hold a thread between repetitions.
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+			std::atomic_int total;
+			total = 0;
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				CommandLib::SequentialCommands::Ptr body = CommandLib::SequentialCommands::Create();
+				body->Add(CommandLib::AsyncPauseCommand::Create(0));
+				body->Add(CommandLibTests::AddCommand::Create(&total, 1));
+
+				parallelCmds->Add(CommandLib::PeriodicCommand::Create(
+					body,
+					3,
+					std::chrono::milliseconds(50),
+					CommandLib::PeriodicCommand::IntervalType::PauseBefore,
+					false));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			parallelCmds->SyncExecute();
+			Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+			Assert::AreEqual((int)total, 3000);
+		}
 	};
 }
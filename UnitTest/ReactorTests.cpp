@@ -0,0 +1,58 @@
+#include "CppUnitTest.h"
+#ifdef __linux__
+#include "Reactor.h"
+#include "Event.h"
+#include <atomic>
+#include <cstdint>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(ReactorTests)
+	{
+	public:
+		TEST_METHOD(Reactor_TestWatchAndUnwatch)
+		{
+			CommandLib::Reactor::Ptr reactor = CommandLib::Reactor::Create();
+			const int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			std::atomic_int count;
+			count = 0;
+			CommandLib::Event ready;
+
+			CommandLib::Reactor::WatchId id = reactor->Watch(fd, EPOLLIN, [&count, &ready]()
+			{
+				++count;
+				ready.Set();
+			});
+
+			Assert::AreNotEqual(0ULL, id);
+			Assert::IsFalse(ready.Wait(10));
+			const uint64_t one = 1;
+			Assert::AreEqual(static_cast<long>(sizeof(one)), static_cast<long>(write(fd, &one, sizeof(one))));
+			Assert::IsTrue(ready.Wait(1000));
+			Assert::AreEqual(1, (int)count);
+
+			Assert::IsTrue(reactor->Unwatch(id));
+			Assert::IsFalse(reactor->Unwatch(id));
+			ready.Reset();
+			Assert::AreEqual(static_cast<long>(sizeof(one)), static_cast<long>(write(fd, &one, sizeof(one))));
+			Assert::IsFalse(ready.Wait(50));
+			Assert::AreEqual(1, (int)count);
+			close(fd);
+		}
+
+		TEST_METHOD(Reactor_TestBadDescriptor)
+		{
+			Assert::ExpectException<std::system_error>([]()
+			{
+				CommandLib::Reactor::Default()->Watch(-1, EPOLLIN, []() {});
+			});
+		}
+	};
+}
+#endif
@@ -5,6 +5,7 @@
 #include "AddCommand.h"
 #include "PauseCommand.h"
 #include "FailingCommand.h"
+#include "ParallelCommands.h"
 #include <limits>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -66,6 +67,15 @@ namespace UnitTest
 				&handler);
 
 			CommonTests::TestAbort(retryableCmd, 10);
+
+			// Abort while waiting to retry
+			handler.Reset(std::numeric_limits<size_t>::max(), std::chrono::hours(24));
+
+			retryableCmd = CommandLib::RetryableCommand::Create(
+				CommandLibTests::FailingCommand::Create(),
+				&handler);
+
+			CommonTests::TestAbort(retryableCmd, 10);
 		}
 
 		TEST_METHOD(RetryableCommand_TestFail)
@@ -78,5 +88,43 @@ namespace UnitTest
 
 			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(retryableCmd);
 		}
+
+		TEST_METHOD(RetryableCommand_TestExponentialBackoff)
+		{
+			CommandLib::RetryableCommand::ExponentialBackoff backoff(20, std::chrono::milliseconds(10), std::chrono::seconds(1));
+			CommandLibTests::FailingCommand::FailException exc("boo hoo");
+			long long waitMS;
+			long long maxWaitMS = 0;
+
+			for (size_t i = 1; i <= 20; ++i)
+			{
+				Assert::IsTrue(backoff.OnCommandFailed(i, exc, &waitMS));
+				Assert::IsTrue(waitMS >= 10 && waitMS <= 1000);
+				maxWaitMS = std::max(maxWaitMS, waitMS);
+			}
+
+			Assert::IsTrue(maxWaitMS > 30); // would need extraordinary luck to never grow
+			Assert::IsFalse(backoff.OnCommandFailed(21, exc, &waitMS));
+			Assert::IsTrue(backoff.OnCommandFailed(1, exc, &waitMS));
+			Assert::IsTrue(waitMS >= 10 && waitMS <= 30);
+
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::RetryableCommand::ExponentialBackoff(1, -1, 10); }, L"Negative base accepted");
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::RetryableCommand::ExponentialBackoff(1, 10, 5); }, L"Cap below base accepted");
+		}
+
+		TEST_METHOD(RetryableCommand_TestManyRetrying)
+		{
+			// Far more commands backing off than there are pool threads
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(false);
+
+			for (int i = 0; i < 500; ++i)
+			{
+				parallelCmds->Add(CommandLib::RetryableCommand::Create(CommandLibTests::FailingCommand::Create(), 3, 10, 100));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			Assert::ExpectException<CommandLibTests::FailingCommand::FailException>([parallelCmds]() { parallelCmds->SyncExecute(); }, L"Expected failure");
+			Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+		}
 	};
 }
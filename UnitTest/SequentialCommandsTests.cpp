@@ -1,15 +1,73 @@
 ﻿#include "CppUnitTest.h"
 #include "SequentialCommands.h"
+#include "ParallelCommands.h"
 #include "CommonTests.h"
 #include "CmdListener.h"
 #include "AddCommand.h"
 #include "PauseCommand.h"
 #include "FailingCommand.h"
+#include "AsyncCommand.h"
+#include "SyncCommand.h"
+#include "ThreadPool.h"
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace UnitTest
 {
+	// Finishes upon a thread of its own, as a command driven by some external library might
+	class ForeignThreadCommand : public CommandLib::AsyncCommand
+	{
+	public:
+		typedef std::shared_ptr<ForeignThreadCommand> Ptr;
+		static Ptr Create() { return Ptr(new ForeignThreadCommand()); }
+		virtual std::string ClassName() const override { return "ForeignThreadCommand"; }
+		std::thread::id ThreadId() const { return m_threadId; }
+	private:
+		ForeignThreadCommand() {}
+
+		virtual void AsyncExecuteImpl(CommandLib::CommandListener* listener) override final
+		{
+			CommandLib::Command::Ptr thisCommand = shared_from_this();
+
+			std::thread([this, thisCommand, listener]()
+			{
+				m_threadId = std::this_thread::get_id();
+				InformListener(listener, nullptr);
+			}).detach();
+		}
+
+		std::thread::id m_threadId;
+	};
+
+	class ThreadRecordingCommand : public CommandLib::SyncCommand
+	{
+	public:
+		typedef std::shared_ptr<ThreadRecordingCommand> Ptr;
+		static Ptr Create() { return Ptr(new ThreadRecordingCommand()); }
+		virtual std::string ClassName() const override { return "ThreadRecordingCommand"; }
+		std::thread::id ThreadId() const { return m_threadId; }
+	private:
+		ThreadRecordingCommand() {}
+
+		virtual void SyncExeImpl() override final
+		{
+			m_threadId = std::this_thread::get_id();
+		}
+
+		std::thread::id m_threadId;
+	};
+
+	// Runs work upon the default pool, but cannot tell its threads apart from any others, as a custom executor might not
+	class PassThroughExecutor : public CommandLib::Executor
+	{
+	public:
+		virtual void Execute(std::function<void()> task) override
+		{
+			CommandLib::ThreadPool::Default()->Execute(task);
+		}
+	};
+
 	TEST_CLASS(SequentialCommandsTests)
 	{
 	public:
@@ -58,6 +116,48 @@ namespace UnitTest
 			seqCmds->Add(CommandLibTests::FailingCommand::Create());
 			seqCmds->Add(CommandLib::PauseCommand::Create(0));
 			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(seqCmds);
+
+			// A naturally asynchronous command fails
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+			parallelCmds->Add(CommandLibTests::FailingCommand::Create());
+			seqCmds = CommandLib::SequentialCommands::Create();
+			seqCmds->Add(CommandLib::PauseCommand::Create(0));
+			seqCmds->Add(parallelCmds);
+			CommonTests::TestFail<CommandLibTests::FailingCommand::FailException>(seqCmds);
+		}
+
+		TEST_METHOD(SequentialCommands_TestLongSequence)
+		{
+			// Far more steps than could be chained upon one thread's stack if each step recursed into the next
+			CommandLib::SequentialCommands::Ptr seqCmds = CommandLib::SequentialCommands::Create();
+			std::atomic_int total;
+			total = 0;
+			const int count = 100000;
+
+			for (int i = 0; i < count; ++i)
+			{
+				seqCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			}
+
+			CommonTests::TestHappyPath(seqCmds);
+			Assert::AreEqual((int)total, 2 * count);
+
+			// Likewise upon an executor whose threads are never known to be its own
+			seqCmds->SetExecutor(std::make_shared<PassThroughExecutor>());
+			CommonTests::TestHappyPath(seqCmds);
+			Assert::AreEqual((int)total, 4 * count);
+		}
+
+		TEST_METHOD(SequentialCommands_TestForeignThreadContinuation)
+		{
+			// The step after one that finishes upon a foreign thread must not block that thread
+			CommandLib::SequentialCommands::Ptr seqCmds = CommandLib::SequentialCommands::Create();
+			ForeignThreadCommand::Ptr foreignCmd = ForeignThreadCommand::Create();
+			ThreadRecordingCommand::Ptr recordingCmd = ThreadRecordingCommand::Create();
+			seqCmds->Add(foreignCmd);
+			seqCmds->Add(recordingCmd);
+			CommonTests::TestHappyPath(seqCmds);
+			Assert::IsTrue(foreignCmd->ThreadId() != recordingCmd->ThreadId());
 		}
 	};
 }
@@ -0,0 +1,113 @@
+#include "CppUnitTest.h"
+#include "ThreadPool.h"
+#include "Event.h"
+#include "ParallelCommands.h"
+#include "AddCommand.h"
+#include "PauseCommand.h"
+#include "CommonTests.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(ThreadPoolTests)
+	{
+	public:
+		TEST_METHOD(ThreadPool_TestPost)
+		{
+			std::atomic_int total;
+			total = 0;
+
+			{
+				CommandLib::ThreadPool::Ptr pool = CommandLib::ThreadPool::Create(2);
+				Assert::AreEqual(pool->ThreadCount(), (size_t)2);
+
+				for (int i = 0; i < 100; ++i)
+				{
+					pool->Execute([&total]() { ++total; });
+				}
+			}
+
+			// Destruction runs whatever work is still queued
+			Assert::AreEqual((int)total, 100);
+		}
+
+		TEST_METHOD(ThreadPool_TestBlockedWorkers)
+		{
+			// Every worker blocks upon work that is posted afterwards. The pool must not deadlock.
+			CommandLib::ThreadPool::Ptr pool = CommandLib::ThreadPool::Create(1);
+			CommandLib::Event first;
+			CommandLib::Event second;
+			pool->Execute([&first, &second]() { first.Set(); second.Wait(); });
+			first.Wait();
+			pool->Execute([&second]() { second.Set(); });
+			Assert::IsTrue(second.Wait(1000));
+		}
+
+		TEST_METHOD(ThreadPool_TestBadArgs)
+		{
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::ThreadPool::Create(0); }, L"Pool with no threads created");
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::ThreadPool::SetDefaultThreadCount(0); }, L"Default pool with no threads configured");
+			CommandLib::ThreadPool::Default();
+			Assert::ExpectException<std::logic_error>([]() { CommandLib::ThreadPool::SetDefaultThreadCount(4); }, L"Default pool resized while in use");
+		}
+
+		TEST_METHOD(ThreadPool_TestStealing)
+		{
+			// All of the work is posted from one worker, upon its own queue. The other workers must steal some of it.
+			CommandLib::ThreadPool::Ptr pool = CommandLib::ThreadPool::Create(4);
+			std::atomic_int remaining;
+			remaining = 100;
+			std::set<std::thread::id> threads;
+			std::mutex mutex;
+			CommandLib::Event done;
+
+			pool->Execute([pool, &remaining, &threads, &mutex, &done]()
+			{
+				for (int i = 0; i < 100; ++i)
+				{
+					pool->Execute([&remaining, &threads, &mutex, &done]()
+					{
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+						{
+							std::lock_guard<std::mutex> lock(mutex);
+							threads.insert(std::this_thread::get_id());
+						}
+
+						if (--remaining == 0)
+						{
+							done.Set();
+						}
+					});
+				}
+			});
+
+			Assert::IsTrue(done.Wait(10000));
+			std::lock_guard<std::mutex> lock(mutex);
+			Assert::IsTrue(threads.size() > 1);
+		}
+
+		TEST_METHOD(ThreadPool_TestWideFanOut)
+		{
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(true);
+			std::atomic_int total;
+			total = 0;
+			const int count = 2000;
+
+			for (int i = 0; i < count; ++i)
+			{
+				parallelCmds->Add(CommandLibTests::AddCommand::Create(&total, 1));
+			}
+
+			parallelCmds->SyncExecute();
+			Assert::AreEqual((int)total, count);
+			parallelCmds->Add(CommandLib::PauseCommand::Create(std::chrono::hours(24)));
+			CommonTests::TestAbort(parallelCmds, 10);
+		}
+	};
+}
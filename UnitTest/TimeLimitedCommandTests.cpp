@@ -4,6 +4,8 @@
 #include "CmdListener.h"
 #include "AddCommand.h"
 #include "PauseCommand.h"
+#include "AsyncPauseCommand.h"
+#include "ParallelCommands.h"
 #include "FailingCommand.h"
 #include "CommandTimeoutException.h"
 
@@ -64,5 +66,21 @@ namespace UnitTest
 			timeLimitedCmd = CommandLib::TimeLimitedCommand::Create(innerCmd, std::chrono::milliseconds(10));
 			CommonTests::TestFail<CommandLib::CommandTimeoutException>(timeLimitedCmd);
         }
+
+		TEST_METHOD(TimeLimitedCommand_TestManyPending)
+		{
+			// Far more timeouts than there are pool threads. None of them should tie up a thread while waiting.
+			CommandLib::ParallelCommands::Ptr parallelCmds = CommandLib::ParallelCommands::Create(false);
+
+			for (int i = 0; i < 500; ++i)
+			{
+				parallelCmds->Add(CommandLib::TimeLimitedCommand::Create(CommandLib::AsyncPauseCommand::Create(10), std::chrono::hours(24)));
+				parallelCmds->Add(CommandLib::TimeLimitedCommand::Create(CommandLib::AsyncPauseCommand::Create(std::chrono::hours(24)), 50));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			Assert::ExpectException<CommandLib::CommandTimeoutException>([parallelCmds]() { parallelCmds->SyncExecute(); }, L"Expected timeouts");
+			Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+		}
 	};
 }
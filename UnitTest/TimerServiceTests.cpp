@@ -0,0 +1,50 @@
+#include "CppUnitTest.h"
+#include "TimerService.h"
+#include "Event.h"
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TimerServiceTests)
+	{
+	public:
+		TEST_METHOD(TimerService_TestOrder)
+		{
+			CommandLib::TimerService::Ptr timers = CommandLib::TimerService::Create();
+			std::mutex mtx;
+			std::vector<int> order;
+			CommandLib::Event done;
+			auto record = [&mtx, &order](int n) { std::unique_lock<std::mutex> lock(mtx); order.push_back(n); };
+			timers->Schedule(60, [&record, &done]() { record(3); done.Set(); });
+			timers->Schedule(std::chrono::milliseconds(20), [&record]() { record(1); });
+			timers->Schedule(40, [&record]() { record(2); });
+			timers->Schedule(-5, [&record]() { record(0); });
+			Assert::IsTrue(done.Wait(1000));
+			std::unique_lock<std::mutex> lock(mtx);
+			Assert::AreEqual(order.size(), (size_t)4);
+
+			for (int i = 0; i < 4; ++i)
+			{
+				Assert::AreEqual(order[i], i);
+			}
+		}
+
+		TEST_METHOD(TimerService_TestCancel)
+		{
+			CommandLib::TimerService::Ptr timers = CommandLib::TimerService::Create();
+			CommandLib::Event cancelled;
+			CommandLib::Event fired;
+			CommandLib::TimerService::TimerId id = timers->Schedule(20, [&cancelled]() { cancelled.Set(); });
+			Assert::AreNotEqual(id, (CommandLib::TimerService::TimerId)0);
+			timers->Schedule(std::chrono::hours(24 * 365 * 1000), [&cancelled]() { cancelled.Set(); });
+			timers->Schedule(40, [&fired]() { fired.Set(); });
+			Assert::IsTrue(timers->Cancel(id));
+			Assert::IsFalse(timers->Cancel(id));
+			Assert::IsTrue(fired.Wait(1000));
+			Assert::IsFalse(cancelled.IsSignaled());
+			Assert::IsFalse(timers->Cancel(0));
+		}
+	};
+}
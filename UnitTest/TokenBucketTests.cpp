@@ -0,0 +1,51 @@
+#include "CppUnitTest.h"
+#include "TokenBucket.h"
+#include <stdexcept>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TokenBucketTests)
+	{
+	public:
+		TEST_METHOD(TokenBucket_TestRate)
+		{
+			CommandLib::TokenBucket bucket(10, 3);
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			// The bucket starts full
+			for (int i = 0; i < 3; ++i)
+			{
+				Assert::IsTrue(bucket.TryTake(start));
+			}
+
+			Assert::IsFalse(bucket.IsAvailable(start));
+			Assert::IsFalse(bucket.TryTake(start));
+			const long long waitMS = bucket.MillisecondsUntilAvailable(start);
+			Assert::IsTrue(waitMS > 0 && waitMS <= 100);
+
+			// One token per 100ms
+			Assert::IsTrue(bucket.TryTake(start + std::chrono::milliseconds(waitMS)));
+			Assert::IsFalse(bucket.TryTake(start + std::chrono::milliseconds(waitMS + 50)));
+			Assert::IsTrue(bucket.TryTake(start + std::chrono::milliseconds(waitMS + 100)));
+
+			// No more than the burst accumulates
+			const std::chrono::steady_clock::time_point later = start + std::chrono::hours(1);
+			Assert::AreEqual(0LL, bucket.MillisecondsUntilAvailable(later));
+
+			for (int i = 0; i < 3; ++i)
+			{
+				Assert::IsTrue(bucket.TryTake(later));
+			}
+
+			Assert::IsFalse(bucket.TryTake(later));
+		}
+
+		TEST_METHOD(TokenBucket_TestBadArgs)
+		{
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::TokenBucket bucket(0, 1); }, L"Zero rate");
+			Assert::ExpectException<std::invalid_argument>([]() { CommandLib::TokenBucket bucket(1, 0.5); }, L"Burst below 1");
+		}
+	};
+}
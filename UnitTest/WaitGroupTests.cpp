@@ -2,6 +2,7 @@
 #include "Event.h"
 #include "WaitGroup.h"
 #include <thread>
+#include <vector>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -104,5 +105,46 @@ namespace UnitTest
 				group.WaitForAll();
 			}
 		}
+
+		TEST_METHOD(WaitGroupTests_TestReuse)
+		{
+			std::vector<CommandLib::Event::Ptr> events;
+
+			{
+				CommandLib::WaitGroup group;
+
+				for (int i = 0; i < 10; ++i)
+				{
+					events.push_back(CommandLib::Event::Ptr(new CommandLib::Event()));
+					group.AddWaitable(events.back());
+				}
+
+				for (int i = 0; i < 1000; ++i)
+				{
+					const int index = i % 10;
+					events[index]->Set();
+					Assert::AreEqual(index, group.WaitForAny());
+					Assert::AreEqual(index, group.WaitForAny(std::chrono::milliseconds(0)));
+					events[index]->Reset();
+				}
+
+				Assert::AreEqual(-1, group.WaitForAny(std::chrono::milliseconds(1)));
+
+				std::thread thread([&events]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					events[7]->Set();
+				});
+
+				Assert::AreEqual(7, group.WaitForAny());
+				thread.join();
+			}
+
+			// The group must not keep the waitables alive after it goes away
+			for (CommandLib::Event::Ptr& ev : events)
+			{
+				Assert::AreEqual(1L, ev.use_count());
+			}
+		}
 	};
 }